@@ -0,0 +1,133 @@
+// 请求扫描的微基准：比较逐字节查找行结束符、strpbrk/strspn拆分请求头的旧做法，
+// 与http/scanner中成批比较的FindLineEnd和SplitHeaderField。
+// 用法：scanner_bench [重复次数]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "http/scanner.h"
+
+namespace
+{
+// 典型的浏览器请求，以及带长Cookie的请求，后者的长行更能体现成批比较的差别
+const char BROWSER_REQUEST[] =
+    "GET /picture.html?from=index HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9006\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "If-None-Match: \"5eb4fe83.0-24d\"\r\n"
+    "If-Modified-Since: Fri, 08 May 2020 06:38:59 GMT\r\n"
+    "\r\n";
+
+std::string LongCookieRequest()
+{
+    std::string request = "GET / HTTP/1.1\r\nHost: 127.0.0.1:9006\r\nCookie: ";
+    for (int i = 0; i < 64; ++i)
+        request += "session_key_" + std::to_string(i) + "=0123456789abcdef0123456789abcdef; ";
+    request += "\r\nAccept: */*\r\n\r\n";
+    return request;
+}
+
+// 旧做法：逐字节找'\r'，请求头用strpbrk找':'再用strspn跳过空白
+size_t ParseScalar(char *buffer, size_t length)
+{
+    size_t fields = 0;
+    size_t start = 0;
+    for (size_t i = 0; i + 1 < length; ++i)
+    {
+        if (buffer[i] != '\r' || buffer[i + 1] != '\n')
+            continue;
+        buffer[i] = '\0';
+        char *line = buffer + start;
+        if (start > 0 && *line)
+        {
+            char *value = strpbrk(line, ":");
+            if (value)
+            {
+                ++value;
+                value += strspn(value, " \t");
+                fields += value[0] != '\0';
+            }
+        }
+        buffer[i] = '\r';
+        start = ++i + 1;
+    }
+    return fields;
+}
+
+// 新做法：FindLineEnd成批跳到'\r'，SplitHeaderField一次拆出字段名和值
+size_t ParseScanner(char *buffer, size_t length)
+{
+    size_t fields = 0;
+    char *end = buffer + length;
+    char *line = buffer;
+    bool first = true;
+    while (true)
+    {
+        char *cr = FindLineEnd(line, end);
+        if (cr + 1 >= end)
+            break;
+        if (!first && cr > line)
+        {
+            HeaderField field;
+            // SplitHeaderField在值的末尾写入'\0'，测完后恢复
+            char saved = *cr;
+            if (SplitHeaderField(line, cr - line, &field))
+                fields += field.value_length_ > 0;
+            *cr = saved;
+        }
+        first = false;
+        line = cr + 2;
+    }
+    return fields;
+}
+
+template <class Parse>
+double Measure(Parse parse, std::vector<char> &buffer, size_t length, int rounds, size_t *fields)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < rounds; ++i)
+        total += parse(buffer.data(), length);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    *fields = total;
+    return elapsed.count() / rounds;
+}
+
+void Run(const char *name, const std::string &request, int rounds)
+{
+    // 多留一些空间，SIMD实现不会读到请求之外，但缓冲区尾部仍须有效
+    std::vector<char> buffer(request.begin(), request.end());
+    buffer.resize(request.size() + 64);
+    size_t scalar_fields, scanner_fields;
+    double scalar = Measure(ParseScalar, buffer, request.size(), rounds, &scalar_fields);
+    double scanner = Measure(ParseScanner, buffer, request.size(), rounds, &scanner_fields);
+    if (scalar_fields != scanner_fields)
+    {
+        printf("%s: field count mismatch (%zu vs %zu)\n", name, scalar_fields, scanner_fields);
+        exit(1);
+    }
+    printf("%-14s %6zu bytes  scalar %8.1f ns (%6.2f GB/s)  %s %8.1f ns (%6.2f GB/s)  speedup %.2fx\n", name,
+           request.size(), scalar, request.size() / scalar, ScannerName(), scanner, request.size() / scanner,
+           scalar / scanner);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (rounds <= 0)
+        rounds = 1000000;
+    Run("browser", BROWSER_REQUEST, rounds);
+    Run("long cookie", LongCookieRequest(), rounds / 10 > 0 ? rounds / 10 : 1);
+    return 0;
+}
@@ -0,0 +1,205 @@
+// 线程池的微基准：比较原来互斥锁保护的std::list加信号量的线程池与现在的工作窃取线程池，
+// 报告每秒完成的任务数和任务从放入到开始执行的排队延迟（p50、p99）。
+// 模拟反应堆的用法：每个生产者线程像一个反应堆，一次放入一批请求（一次epoll_wait返回的就绪连接），
+// 等这批请求都处理完后再放下一批；请求对象复用，以在途计数判断处理是否结束。
+// 用法：thread_pool_bench [每个生产者的批数] [工作线程数]
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "semaphore/semaphore.h"
+#include "threadpool/thread_pool.h"
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+// 每批的请求数
+const int BATCH = 64;
+
+struct BenchRequest
+{
+    BenchRequest() : mysql_(nullptr), in_flight_(0), work_(0), latency_ns_(0) {}
+    void Process()
+    {
+        latency_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - enqueued_).count();
+        // 模拟解析请求和组织响应的开销
+        volatile unsigned sink = 0;
+        for (int i = 0; i < work_; ++i)
+            sink = sink * 31 + i;
+    }
+
+    MYSQL *mysql_;
+    std::atomic<int> in_flight_;
+    int work_;
+    Clock::time_point enqueued_;
+    long latency_ns_;
+};
+
+// 原来的线程池：互斥锁保护的std::list，信号量表示任务数，所有线程争抢同一把锁。
+// 只改为析构时唤醒并等待线程退出，取任务后的执行部分与ThreadPool::Execute相同，两者的差别只在调度上
+template <class Request>
+class LockedPool
+{
+    typedef std::lock_guard<std::mutex> Lock;
+
+public:
+    LockedPool(ConnectPool *conn_pool, size_t thread_number, size_t max_request)
+        : thread_number_(thread_number), max_requests_(max_request), stop_(false), sql_conn_pool_(conn_pool)
+    {
+        threads_ = new pthread_t[thread_number_];
+        for (size_t i = 0; i < thread_number_; ++i)
+            pthread_create(threads_ + i, nullptr, Worker, this);
+    }
+    ~LockedPool()
+    {
+        stop_ = true;
+        for (size_t i = 0; i < thread_number_; ++i)
+            queue_state_.notify();
+        for (size_t i = 0; i < thread_number_; ++i)
+            pthread_join(threads_[i], nullptr);
+        delete[] threads_;
+    }
+    bool Append(Request *request)
+    {
+        {
+            Lock locker(mutex_);
+            if (work_queue_.size() > max_requests_)
+                return false;
+            work_queue_.push_back(request);
+        }
+        queue_state_.notify();
+        return true;
+    }
+
+private:
+    static void *Worker(void *arg)
+    {
+        static_cast<LockedPool *>(arg)->Run();
+        return arg;
+    }
+    void Run()
+    {
+        while (!stop_)
+        {
+            Request *request;
+            queue_state_.wait();
+            {
+                Lock locker(mutex_);
+                if (work_queue_.empty())
+                    continue;
+                request = work_queue_.front();
+                work_queue_.pop_front();
+            }
+            CoarseClock::Refresh();
+            MYSQL *mysql = sql_conn_pool_->GetConnetion();
+            request->mysql_ = mysql;
+            request->Process();
+            sql_conn_pool_->ReleaseConnection(mysql);
+            request->in_flight_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    size_t thread_number_;
+    size_t max_requests_;
+    pthread_t *threads_;
+    std::list<Request *> work_queue_;
+    std::mutex mutex_;
+    Semaphore queue_state_;
+    std::atomic<bool> stop_;
+    ConnectPool *sql_conn_pool_;
+};
+
+struct Result
+{
+    double tasks_per_second_;
+    double p50_us_;
+    double p99_us_;
+};
+
+// 一个生产者：按批放入请求，等整批处理完，记下每个请求的排队延迟
+template <class Pool>
+void Produce(Pool *pool, int batches, int work, std::vector<long> *latencies)
+{
+    std::vector<BenchRequest> requests(BATCH);
+    latencies->reserve((size_t)batches * BATCH);
+    for (int batch = 0; batch < batches; ++batch)
+    {
+        for (BenchRequest &request : requests)
+        {
+            request.work_ = work;
+            request.in_flight_.store(1, std::memory_order_relaxed);
+            request.enqueued_ = Clock::now();
+            while (!pool->Append(&request))
+                std::this_thread::yield();
+        }
+        for (BenchRequest &request : requests)
+        {
+            while (request.in_flight_.load(std::memory_order_acquire) > 0)
+                std::this_thread::yield();
+            latencies->push_back(request.latency_ns_);
+        }
+    }
+}
+
+template <class Pool>
+Result Run(ConnectPool *conn_pool, size_t threads, int producers, int batches, int work)
+{
+    Pool pool(conn_pool, threads, MAX_EVENT_NUMBER);
+    std::vector<std::vector<long>> latencies(producers);
+    std::vector<std::thread> producer_threads;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < producers; ++i)
+        producer_threads.emplace_back(Produce<Pool>, &pool, batches, work, &latencies[i]);
+    for (std::thread &thread : producer_threads)
+        thread.join();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    std::vector<long> all;
+    for (const std::vector<long> &part : latencies)
+        all.insert(all.end(), part.begin(), part.end());
+    size_t p50 = all.size() / 2;
+    size_t p99 = all.size() * 99 / 100;
+    std::nth_element(all.begin(), all.begin() + p50, all.end());
+    long p50_ns = all[p50];
+    std::nth_element(all.begin(), all.begin() + p99, all.end());
+    return {all.size() / elapsed.count(), p50_ns / 1000.0, all[p99] / 1000.0};
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int batches = argc > 1 ? atoi(argv[1]) : 2000;
+    if (batches <= 0)
+        batches = 2000;
+    size_t threads = argc > 2 ? atoi(argv[2]) : THREAD_NUMBER;
+    if (threads == 0)
+        threads = THREAD_NUMBER;
+    // 不连接数据库，取连接只经过连接池的锁，与服务器未配置数据库时相同
+    ConnectPool *conn_pool = ConnectPool::GetInstance("", "", "", "", 0, 0);
+
+    printf("%zu worker threads, %d batches of %d requests per producer, %u cpus\n", threads, batches, BATCH,
+           std::thread::hardware_concurrency());
+    for (int producers : {1, 4})
+    {
+        for (int work : {0, 2000})
+        {
+            Result locked = Run<LockedPool<BenchRequest>>(conn_pool, threads, producers, batches, work);
+            Result stealing = Run<ThreadPool<BenchRequest>>(conn_pool, threads, producers, batches, work);
+            printf("producers %d  work %4d  locked list %9.0f tasks/s  p50 %7.1f us  p99 %7.1f us  |  "
+                   "work stealing %9.0f tasks/s  p50 %7.1f us  p99 %7.1f us\n",
+                   producers, work, locked.tasks_per_second_, locked.p50_us_, locked.p99_us_,
+                   stealing.tasks_per_second_, stealing.p50_us_, stealing.p99_us_);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
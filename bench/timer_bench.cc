@@ -0,0 +1,229 @@
+// 定时器的微基准：在1K、10K、100K个连接下比较原来的升序链表与分层时间轮。
+// 模拟服务器的稳态：每个连接一个空闲超时定时器，随机的连接有读写（推迟超时）或者关闭后由新连接补上，
+// 时间每TIMER_TICK_MS毫秒推进一格，到期的连接在回调中被新连接替换，连接数保持不变。
+// 链表每次推迟或新增都要从插入点向后遍历，连接越多它的操作次数按比例减少，结果都折算为每次操作的时间。
+// 用法：timer_bench [时间轮每种规模的操作次数]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "time/lst_time.h"
+#include "time/timing_wheel.h"
+
+namespace
+{
+const time_t TICK_MS = 100;
+const time_t TIMEOUT_MS = 15000;
+// 每次操作中推迟超时的比例，其余为关闭后接入新连接
+const int REFRESH_PERCENT = 80;
+// 平均每隔多少次操作推进一格
+const int OPERATIONS_PER_TICK = 64;
+
+// 原来的升序双向链表（SortedTimerList），只保留算法本身：定时器不再由链表释放，
+// 时间由参数传入，与时间轮一样是侵入式的，两者的差别只在数据结构上
+class SortedList
+{
+public:
+    SortedList() : head_(nullptr), tail_(nullptr) {}
+
+    void AddTimer(UtilTimer *timer)
+    {
+        timer->prev_ = timer->next_ = nullptr;
+        if (!head_)
+        {
+            head_ = tail_ = timer;
+            return;
+        }
+        if (timer->expire_time_ < head_->expire_time_)
+        {
+            timer->next_ = head_;
+            head_->prev_ = timer;
+            head_ = timer;
+            return;
+        }
+        Insert(timer, head_);
+    }
+    void AdjustTimer(UtilTimer *timer)
+    {
+        UtilTimer *next = timer->next_;
+        if (!next || timer->expire_time_ < next->expire_time_)
+            return;
+        if (timer == head_)
+        {
+            head_ = next;
+            head_->prev_ = nullptr;
+        }
+        else
+        {
+            timer->prev_->next_ = next;
+            next->prev_ = timer->prev_;
+        }
+        Insert(timer, next);
+    }
+    void RemoveTimer(UtilTimer *timer)
+    {
+        if (timer->prev_)
+            timer->prev_->next_ = timer->next_;
+        else
+            head_ = timer->next_;
+        if (timer->next_)
+            timer->next_->prev_ = timer->prev_;
+        else
+            tail_ = timer->prev_;
+        timer->prev_ = timer->next_ = nullptr;
+    }
+    void Tick(time_t now)
+    {
+        while (head_ && head_->expire_time_ <= now)
+        {
+            UtilTimer *timer = head_;
+            head_ = timer->next_;
+            if (head_)
+                head_->prev_ = nullptr;
+            else
+                tail_ = nullptr;
+            timer->prev_ = timer->next_ = nullptr;
+            timer->cb_func_(timer->user_data_);
+        }
+    }
+
+private:
+    // 从start开始向后找第一个不早于timer的位置
+    void Insert(UtilTimer *timer, UtilTimer *start)
+    {
+        UtilTimer *prev = start->prev_;
+        UtilTimer *current = start;
+        while (current && timer->expire_time_ > current->expire_time_)
+        {
+            prev = current;
+            current = current->next_;
+        }
+        timer->prev_ = prev;
+        timer->next_ = current;
+        if (prev)
+            prev->next_ = timer;
+        else
+            head_ = timer;
+        if (current)
+            current->prev_ = timer;
+        else
+            tail_ = timer;
+    }
+
+    UtilTimer *head_;
+    UtilTimer *tail_;
+};
+
+// 时间轮的Tick返回是否还有定时器，这里统一成无返回值的接口
+struct Wheel
+{
+    Wheel() : wheel_(TICK_MS) {}
+    void AddTimer(UtilTimer *timer) { wheel_.AddTimer(timer); }
+    void AdjustTimer(UtilTimer *timer) { wheel_.AdjustTimer(timer); }
+    void RemoveTimer(UtilTimer *timer) { wheel_.RemoveTimer(timer); }
+    void Tick(time_t now) { wheel_.Tick(now); }
+    TimingWheel wheel_;
+};
+
+// 超时回调中由新连接补上的位置，模拟时的当前时间
+template <class Timers>
+struct Simulation
+{
+    Timers *timers_;
+    time_t now_;
+    long expired_;
+};
+
+template <class Timers>
+Simulation<Timers> *current_simulation = nullptr;
+
+template <class Timers>
+void Reconnect(ClientData *user_data)
+{
+    Simulation<Timers> *simulation = current_simulation<Timers>;
+    ++simulation->expired_;
+    user_data->timer_.expire_time_ = simulation->now_ + TIMEOUT_MS;
+    simulation->timers_->AddTimer(&user_data->timer_);
+}
+
+struct Result
+{
+    double ns_per_operation_;
+    long expired_;
+};
+
+template <class Timers>
+Result Run(size_t connections, long operations, unsigned seed)
+{
+    std::vector<ClientData> clients(connections);
+    Timers timers;
+    Simulation<Timers> simulation = {&timers, 0, 0};
+    current_simulation<Timers> = &simulation;
+    // 初始的到期时间均匀分布在一个超时周期内；按到期时间从晚到早加入，链表每次都插在表头，预填不计时
+    for (size_t i = connections; i-- > 0;)
+    {
+        UtilTimer &timer = clients[i].timer_;
+        timer.cb_func_ = Reconnect<Timers>;
+        timer.user_data_ = &clients[i];
+        timer.expire_time_ = TICK_MS + (time_t)(TIMEOUT_MS * i / connections);
+        timers.AddTimer(&timer);
+    }
+    std::mt19937 random(seed);
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < operations; ++i)
+    {
+        UtilTimer &timer = clients[random() % connections].timer_;
+        timer.expire_time_ = simulation.now_ + TIMEOUT_MS;
+        if ((int)(random() % 100) < REFRESH_PERCENT)
+        {
+            timers.AdjustTimer(&timer);
+        }
+        else
+        {
+            timers.RemoveTimer(&timer);
+            timers.AddTimer(&timer);
+        }
+        if (i % OPERATIONS_PER_TICK == 0)
+        {
+            simulation.now_ += TICK_MS;
+            timers.Tick(simulation.now_);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return {elapsed.count() / operations, simulation.expired_};
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long operations = argc > 1 ? atol(argv[1]) : 1000000;
+    if (operations <= 0)
+        operations = 1000000;
+    printf("%d%% refresh / %d%% reconnect, one %ld ms tick every %d operations, %ld ms idle timeout\n",
+           REFRESH_PERCENT, 100 - REFRESH_PERCENT, (long)TICK_MS, OPERATIONS_PER_TICK, (long)TIMEOUT_MS);
+    for (size_t connections : {1000, 10000, 100000})
+    {
+        long list_operations = operations / 10 * 1000 / connections;
+        if (list_operations < 1000)
+            list_operations = 1000;
+        Result list = Run<SortedList>(connections, list_operations, 1);
+        // 两者的到期顺序可能不同，但同样的操作序列下到期的连接数应当一致
+        Result check = Run<Wheel>(connections, list_operations, 1);
+        if (list.expired_ != check.expired_)
+        {
+            printf("%zu connections: expired count mismatch (%ld vs %ld)\n", connections, list.expired_,
+                   check.expired_);
+            return 1;
+        }
+        Result wheel = Run<Wheel>(connections, operations, 1);
+        printf("%7zu connections  sorted list %10.1f ns/op (%6ld ops)  timing wheel %6.1f ns/op (%ld ops)  "
+               "speedup %7.1fx\n",
+               connections, list.ns_per_operation_, list_operations, wheel.ns_per_operation_, operations,
+               list.ns_per_operation_ / wheel.ns_per_operation_);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpu_placement.h"
+#include "logger/logger.h"
+
+#include "config.inc"
+
+namespace
+{
+// 当前线程绑定到的节点，-1表示未绑定
+thread_local int pinned_node = -1;
+
+// 解析"0-3,8,10-11"格式的CPU或节点列表
+std::vector<int> ParseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ','))
+    {
+        int first, last;
+        int count = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (count <= 0)
+            continue;
+        if (count == 1)
+            last = first;
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+std::string ReadLine(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// 把升序的CPU编号写成"0-3,8"
+std::string FormatCpuList(const std::vector<int> &cpus)
+{
+    std::string list;
+    for (size_t i = 0; i < cpus.size();)
+    {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            ++j;
+        if (!list.empty())
+            list += ',';
+        list += std::to_string(cpus[i]);
+        if (j > i)
+            list += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return list;
+}
+
+// 本进程所在cgroup的有效cpuset，cgroup v2和v1都找不到时返回空
+std::string ReadCgroupCpuset(std::string *source)
+{
+    std::ifstream cgroup("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroup, line))
+    {
+        // 每行为"层级:控制器:路径"，v2的控制器为空
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos)
+            continue;
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        if (path == "/")
+            path.clear();
+        std::string file;
+        if (controllers.empty())
+            file = "/sys/fs/cgroup" + path + "/cpuset.cpus.effective";
+        else if (("," + controllers + ",").find(",cpuset,") != std::string::npos)
+            file = "/sys/fs/cgroup/cpuset" + path + "/cpuset.effective_cpus";
+        else
+            continue;
+        std::string cpus = ReadLine(file);
+        if (!cpus.empty())
+        {
+            *source = file;
+            return cpus;
+        }
+    }
+    return std::string();
+}
+} // namespace
+
+CpuPlacement::CpuPlacement() : recorded_count_(0)
+{
+    // 可用的CPU取进程亲和性、cgroup cpuset和CPU_LIST的交集
+    cpu_set_t affinity;
+    CPU_ZERO(&affinity);
+    sched_getaffinity(0, sizeof(affinity), &affinity);
+    std::vector<int> cpuset = ParseCpuList(ReadCgroupCpuset(&source_));
+    if (cpuset.empty())
+        source_ = "sched_getaffinity";
+    std::vector<int> configured = ParseCpuList(CPU_LIST);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &affinity))
+            continue;
+        if (!cpuset.empty() && std::find(cpuset.begin(), cpuset.end(), cpu) == cpuset.end())
+            continue;
+        if (!configured.empty() && std::find(configured.begin(), configured.end(), cpu) == configured.end())
+            continue;
+        cpus_.push_back(cpu);
+    }
+    if (cpus_.empty())
+    {
+        LOG_WARN("%s", "no usable cpu in cpuset and CPU_LIST, falling back to cpu 0");
+        cpus_.push_back(0);
+    }
+
+    node_of_cpu_.assign(cpus_.back() + 1, -1);
+    // 节点编号可能不连续，以possible列出的为准
+    for (int node : ParseCpuList(ReadLine("/sys/devices/system/node/possible")))
+    {
+        std::string list = ReadLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::vector<int> local;
+        for (int cpu : ParseCpuList(list))
+        {
+            if (cpu < (int)node_of_cpu_.size() && node_of_cpu_[cpu] < 0 &&
+                std::binary_search(cpus_.begin(), cpus_.end(), cpu))
+                local.push_back(cpu);
+        }
+        if (local.empty())
+            continue;
+        for (int cpu : local)
+            node_of_cpu_[cpu] = nodes_.size();
+        nodes_.push_back(local);
+        node_ids_.push_back(node);
+    }
+    // 没有NUMA信息或有CPU不属于任何节点时，归入同一个节点
+    std::vector<int> orphans;
+    for (int cpu : cpus_)
+    {
+        if (node_of_cpu_[cpu] < 0)
+            orphans.push_back(cpu);
+    }
+    if (!orphans.empty())
+    {
+        for (int cpu : orphans)
+            node_of_cpu_[cpu] = nodes_.size();
+        nodes_.push_back(orphans);
+        node_ids_.push_back(node_ids_.empty() ? 0 : -1);
+    }
+}
+
+bool CpuPlacement::Pin(const std::vector<int> &cpus, const char *role, int index) const
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0)
+    {
+        LOG_WARN("pin %s %d to cpus %s failed, errno is: %d", role, index, FormatCpuList(cpus).c_str(), ret);
+        return false;
+    }
+    return true;
+}
+
+void CpuPlacement::Record(const char *role, int index, bool pinned)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+    // 实际的CPU都在同一个节点上时报告该节点
+    int node = cpus.empty() || cpus[0] >= (int)node_of_cpu_.size() ? -1 : node_of_cpu_[cpus[0]];
+    for (int cpu : cpus)
+    {
+        if (cpu >= (int)node_of_cpu_.size() || node_of_cpu_[cpu] != node)
+            node = -1;
+    }
+    std::string result = std::string(role) + " -> cpus " + FormatCpuList(cpus) +
+                         (node >= 0 ? " (node " + std::to_string(node_ids_[node]) + ")" : " (several nodes)") +
+                         (pinned ? "" : ", pin failed");
+    std::lock_guard<std::mutex> locker(mutex_);
+    results_[result].push_back(index);
+    ++recorded_count_;
+    recorded_.notify_all();
+}
+
+void CpuPlacement::PlaceReactor(int index)
+{
+#ifdef CPU_AFFINITY
+    int cpu = ReactorCpu(index);
+    bool pinned = Pin(std::vector<int>(1, cpu), "reactor", index);
+    if (pinned)
+        pinned_node = node_of_cpu_[cpu];
+    Record("reactor", index, pinned);
+#else
+    (void)index;
+#endif
+}
+
+void CpuPlacement::PlaceWorker(int index)
+{
+#ifdef CPU_AFFINITY
+    int node = WorkerNode(index);
+    bool pinned = Pin(nodes_[node], "worker", index);
+    if (pinned)
+        pinned_node = node;
+    Record("worker", index, pinned);
+#else
+    (void)index;
+#endif
+}
+
+int CpuPlacement::CurrentNode() const
+{
+    if (pinned_node >= 0)
+        return pinned_node;
+    int cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= (int)node_of_cpu_.size() || node_of_cpu_[cpu] < 0)
+        return 0;
+    return node_of_cpu_[cpu];
+}
+
+void CpuPlacement::Report(int reactor_number, int worker_number)
+{
+    std::string report = "cpu placement: " + std::to_string(cpus_.size()) + " cpus (" + FormatCpuList(cpus_) +
+                         ") from " + source_ + ", " + std::to_string(nodes_.size()) + " numa nodes";
+    for (size_t node = 0; node < nodes_.size(); ++node)
+        report += "\n  node " + std::to_string(node_ids_[node]) + ": cpus " + FormatCpuList(nodes_[node]);
+#ifdef CPU_AFFINITY
+    // 报告各线程绑定后的实际结果，而不是预定的布局
+    std::unique_lock<std::mutex> locker(mutex_);
+    int expected = reactor_number + worker_number;
+    recorded_.wait_for(locker, std::chrono::seconds(1), [&] { return recorded_count_ >= expected; });
+    for (const auto &result : results_)
+    {
+        // 键以"reactor"或"worker"开头，序号列在角色之后
+        size_t role = result.first.find(' ');
+        report += "\n  " + result.first.substr(0, role) + (result.second.size() > 1 ? "s " : " ");
+        std::vector<int> indexes = result.second;
+        std::sort(indexes.begin(), indexes.end());
+        report += FormatCpuList(indexes) + result.first.substr(role);
+    }
+    if (recorded_count_ < expected)
+        report += "\n  " + std::to_string(expected - recorded_count_) + " threads not placed yet";
+    locker.unlock();
+#else
+    report += "\n  " + std::to_string(reactor_number) + " reactors and " + std::to_string(worker_number) +
+              " workers not pinned (CPU_AFFINITY undefined)";
+#endif
+    printf("%s\n", report.c_str());
+    LOG_INFO("%s", report.c_str());
+}
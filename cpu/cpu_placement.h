@@ -0,0 +1,68 @@
+#ifndef CPU_CPUPLACEMENT_H
+#define CPU_CPUPLACEMENT_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 线程的CPU和NUMA节点布局。启动时读取cgroup cpuset与进程亲和性的交集、
+// CPU_LIST的限制和/sys中的NUMA拓扑；定义CPU_AFFINITY时第i个反应堆绑定到第i个CPU，
+// 工作线程按节点轮流绑定到节点内的全部CPU。
+// 收发缓冲区由BufferPool按节点分配（mbind）；其余内存依赖Linux的首次访问策略，线程绑定后自己写入的内存在本节点上
+class CpuPlacement
+{
+public:
+    // 采用局部静态对象实现的单例
+    static CpuPlacement *GetInstance()
+    {
+        static CpuPlacement instance;
+        return &instance;
+    }
+
+    // 本进程可用的CPU数和NUMA节点数，节点以0起的下标表示
+    int CpuCount() const { return cpus_.size(); }
+    int NodeCount() const { return nodes_.size(); }
+    // 节点下标对应的系统节点编号，-1表示未知
+    int NodeId(int node) const { return node_ids_[node]; }
+
+    // 由线程自己调用，按序号绑定并记录所在节点；未定义CPU_AFFINITY时只记录序号
+    void PlaceReactor(int index);
+    void PlaceWorker(int index);
+    // 当前线程所在的NUMA节点，线程未绑定到节点时按当前运行的CPU查找
+    int CurrentNode() const;
+
+    // 在标准输出和日志中报告布局，以及各线程绑定后读回的实际亲和性。
+    // 启动时在各线程开始绑定后调用一次，最多等待一秒，届时仍未绑定的线程报告为未完成
+    void Report(int reactor_number, int worker_number);
+
+private:
+    CpuPlacement();
+    CpuPlacement(const CpuPlacement &) = delete;
+    CpuPlacement &operator=(const CpuPlacement &) = delete;
+
+    int ReactorCpu(int index) const { return cpus_[index % cpus_.size()]; }
+    int WorkerNode(int index) const { return index % nodes_.size(); }
+    // 把当前线程绑定到cpus，失败时记录日志
+    bool Pin(const std::vector<int> &cpus, const char *role, int index) const;
+    // 读回当前线程的亲和性，按结果归类记下线程序号
+    void Record(const char *role, int index, bool pinned);
+
+    // 可用的CPU，升序
+    std::vector<int> cpus_;
+    // 每个节点上的可用CPU，不含没有可用CPU的节点；节点在系统中的编号，-1表示未知
+    std::vector<std::vector<int>> nodes_;
+    std::vector<int> node_ids_;
+    // 按CPU编号索引的节点下标，-1表示不可用
+    std::vector<int> node_of_cpu_;
+    // cpuset的来源，用于报告
+    std::string source_;
+    // 各线程绑定的结果，键为结果的描述，值为得到该结果的线程序号；以及已记录的线程数
+    std::mutex mutex_;
+    std::condition_variable recorded_;
+    std::map<std::string, std::vector<int>> results_;
+    int recorded_count_;
+};
+
+#endif
@@ -0,0 +1,446 @@
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include <brotli/encode.h>
+#include <zlib.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <tuple>
+#include <vector>
+
+#include "file_cache.h"
+#include "logger/logger.h"
+#include "time/coarse_clock.h"
+#include "config.inc"
+
+namespace
+{
+// 引起条目失效的inotify事件
+const uint32_t WATCH_EVENTS = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                              IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+// 输出命中统计的间隔，单位为秒
+const int STATISTICS_INTERVAL = 60;
+
+struct MimeType
+{
+    const char *extension_;
+    const char *type_;
+    bool compressible_;
+};
+// 按扩展名确定的内容类型，未列出的扩展名作为不压缩的二进制数据
+const MimeType MIME_TYPES[] = {
+    {".html", "text/html", true},
+    {".htm", "text/html", true},
+    {".css", "text/css", true},
+    {".js", "application/javascript", true},
+    {".json", "application/json", true},
+    {".txt", "text/plain", true},
+    {".xml", "text/xml", true},
+    {".svg", "image/svg+xml", true},
+    {".ico", "image/x-icon", true},
+    {".jpg", "image/jpeg", false},
+    {".jpeg", "image/jpeg", false},
+    {".png", "image/png", false},
+    {".gif", "image/gif", false},
+    {".webp", "image/webp", false},
+    {".mp4", "video/mp4", false},
+    {".webm", "video/webm", false},
+    {".mp3", "audio/mpeg", false},
+    {".pdf", "application/pdf", false},
+    {".zip", "application/zip", false},
+    {".gz", "application/gzip", false},
+};
+const MimeType DEFAULT_MIME_TYPE = {"", "application/octet-stream", false};
+// 各编码的Content-Encoding取值和预压缩文件的后缀
+const char *const ENCODING_NAMES[ENCODING_COUNT] = {"identity", "gzip", "br"};
+const char *const ENCODING_SUFFIXES[ENCODING_COUNT] = {"", ".gz", ".br"};
+
+const MimeType &FindMimeType(const std::string &path)
+{
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+        return DEFAULT_MIME_TYPE;
+    const char *extension = path.c_str() + dot;
+    for (const MimeType &mime : MIME_TYPES)
+    {
+        if (strcasecmp(extension, mime.extension_) == 0)
+            return mime;
+    }
+    return DEFAULT_MIME_TYPE;
+}
+
+// 强实体标签，文件内容变化时修改时间或长度随之变化
+std::string MakeETag(const struct stat &file_stat)
+{
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%llx.%lx-%llx\"", (unsigned long long)file_stat.st_mtim.tv_sec,
+             (unsigned long)file_stat.st_mtim.tv_nsec, (unsigned long long)file_stat.st_size);
+    return etag;
+}
+
+std::string BuildHeaders(const CachedFile &file, ContentEncoding encoding)
+{
+    char headers[512];
+    int length = snprintf(headers, sizeof(headers),
+                          "HTTP/1.1 200 OK\r\nContent-Length: %lld\r\nContent-Type:%s\r\nLast-Modified: %s\r\nETag: %s\r\n",
+                          (long long)file.length_, file.content_type_, file.last_modified_.c_str(),
+                          file.etag_.c_str());
+    // 只有原文件支持范围请求
+    if (encoding != ENCODING_IDENTITY)
+        length += snprintf(headers + length, sizeof(headers) - length, "Content-Encoding: %s\r\n",
+                           ENCODING_NAMES[encoding]);
+    else
+        length += snprintf(headers + length, sizeof(headers) - length, "Accept-Ranges: bytes\r\n");
+    // 可压缩的文件按请求的Accept-Encoding返回不同的正文，未压缩的响应也要告知缓存
+    if (file.compressible_)
+        snprintf(headers + length, sizeof(headers) - length, "Vary: Accept-Encoding\r\n");
+    return headers;
+}
+
+bool Gzip(const std::string &input, std::string *output)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // windowBits加16生成gzip格式而不是zlib格式
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    output->resize(deflateBound(&stream, input.size()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream.avail_in = input.size();
+    stream.next_out = reinterpret_cast<Bytef *>(&(*output)[0]);
+    stream.avail_out = output->size();
+    int ret = deflate(&stream, Z_FINISH);
+    output->resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+bool Brotli(const std::string &input, std::string *output)
+{
+    size_t length = BrotliEncoderMaxCompressedSize(input.size());
+    if (length == 0)
+        return false;
+    output->resize(length);
+    if (!BrotliEncoderCompress(COMPRESS_BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, input.size(),
+                               reinterpret_cast<const uint8_t *>(input.data()), &length,
+                               reinterpret_cast<uint8_t *>(&(*output)[0])))
+        return false;
+    output->resize(length);
+    return true;
+}
+} // namespace
+
+CachedFile::~CachedFile()
+{
+    if (fd_ != -1)
+        close(fd_);
+}
+
+FileCache::~FileCache()
+{
+    stop_ = true;
+    if (watcher_.joinable())
+        watcher_.join();
+    if (inotify_fd_ != -1)
+        close(inotify_fd_);
+}
+
+bool FileCache::Initialize(const std::string &root, size_t max_files)
+{
+    max_files_ = max_files;
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0)
+    {
+        // 无法监视文件变化时不启用缓存
+        max_files_ = 0;
+        LOG_ERROR("inotify_init1 failed, errno is: %d", errno);
+        return false;
+    }
+    Watch(root);
+    watcher_ = std::thread(&FileCache::WatchLoop, this);
+    return true;
+}
+
+void FileCache::Watch(const std::string &dir)
+{
+    int wd = inotify_add_watch(inotify_fd_, dir.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+    if (wd < 0)
+    {
+        LOG_ERROR("inotify_add_watch %s failed, errno is: %d", dir.c_str(), errno);
+        return;
+    }
+    watch_dirs_[wd] = dir;
+    DIR *handle = opendir(dir.c_str());
+    if (!handle)
+        return;
+    while (dirent *entry = readdir(handle))
+    {
+        std::string name = entry->d_name;
+        if (entry->d_type == DT_DIR && name != "." && name != "..")
+            Watch(dir + "/" + name);
+    }
+    closedir(handle);
+}
+
+std::shared_ptr<const CachedFile> FileCache::Get(const std::string &path)
+{
+    {
+        std::shared_lock<std::shared_mutex> locker(mutex_);
+        auto it = files_.find(path);
+        if (it != files_.end())
+        {
+            // 已经设置过的标记不再写，命中多的条目不会在各线程间来回争用缓存行
+            if (!it->second.referenced_.load(std::memory_order_relaxed))
+                it->second.referenced_.store(true, std::memory_order_relaxed);
+            Pending pending = it->second.pending_;
+            locker.unlock();
+            ++hits_;
+            return pending.get();
+        }
+    }
+
+    std::promise<std::shared_ptr<const CachedFile>> promise;
+    {
+        std::unique_lock<std::shared_mutex> locker(mutex_);
+        auto it = files_.find(path);
+        if (it != files_.end())
+        {
+            // 其他线程正在加载同一个文件，等待它的结果
+            Pending pending = it->second.pending_;
+            locker.unlock();
+            ++hits_;
+            return pending.get();
+        }
+        // 文件路径中重复的'/'会使同一文件有多个键，inotify失效时只能找到其中一个，这样的路径不缓存
+        if (max_files_ > 0 && path.find("//") == std::string::npos)
+        {
+            if (files_.size() >= max_files_)
+                EvictOne();
+            auto inserted = files_.emplace(std::piecewise_construct, std::forward_as_tuple(path),
+                                           std::forward_as_tuple(promise.get_future().share()));
+            inserted.first->second.clock_ = clock_.insert(hand_, path);
+        }
+    }
+    ++misses_;
+    std::shared_ptr<const CachedFile> file = Load(path);
+    promise.set_value(file);
+    if (!file)
+    {
+        // 不存在的文件不缓存。条目可能已被失效并由其他线程重新加载，删掉也只是少一次命中
+        std::unique_lock<std::shared_mutex> locker(mutex_);
+        auto it = files_.find(path);
+        if (it != files_.end())
+            Erase(it);
+    }
+    return file;
+}
+
+void FileCache::Erase(FileMap::iterator it)
+{
+    if (hand_ == it->second.clock_)
+        ++hand_;
+    clock_.erase(it->second.clock_);
+    files_.erase(it);
+}
+
+void FileCache::EvictOne()
+{
+    // 指针经过的条目清除访问标记，遇到自上次经过后没有被访问的条目就淘汰它，最多转两圈
+    while (!clock_.empty())
+    {
+        if (hand_ == clock_.end())
+            hand_ = clock_.begin();
+        auto it = files_.find(*hand_);
+        if (it->second.referenced_.exchange(false, std::memory_order_relaxed))
+        {
+            ++hand_;
+            continue;
+        }
+        Erase(it);
+        return;
+    }
+}
+
+std::shared_ptr<const CachedFile> FileCache::Load(const std::string &path)
+{
+    std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>();
+    if (stat(path.c_str(), &file->stat_) < 0)
+        return nullptr;
+    if (S_ISREG(file->stat_.st_mode) && (file->stat_.st_mode & S_IROTH))
+    {
+        const MimeType &mime = FindMimeType(path);
+        file->fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        // 文件大多从头顺序发送，加大预读窗口
+        if (file->fd_ >= 0)
+            posix_fadvise(file->fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        file->length_ = file->stat_.st_size;
+        char date[64];
+        struct tm modified;
+        gmtime_r(&file->stat_.st_mtime, &modified);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &modified);
+        file->last_modified_ = date;
+        file->etag_ = MakeETag(file->stat_);
+        file->content_type_ = mime.type_;
+        file->compressible_ = mime.compressible_;
+        file->headers_ = BuildHeaders(*file, ENCODING_IDENTITY);
+    }
+    return file;
+}
+
+std::shared_ptr<const CachedFile> FileCache::GetEncoded(const std::shared_ptr<const CachedFile> &file,
+                                                        const std::string &path, unsigned accepted)
+{
+    if (!file->compressible_)
+        return file;
+    for (ContentEncoding encoding : {ENCODING_BROTLI, ENCODING_GZIP})
+    {
+        if (!(accepted & (1u << encoding)))
+            continue;
+        // 同一变体只加载一次，并发的请求等待同一个结果
+        std::call_once(file->encoded_once_[encoding],
+                       [&] { file->encoded_[encoding] = LoadEncoded(*file, path, encoding); });
+        if (file->encoded_[encoding])
+            return file->encoded_[encoding];
+    }
+    return file;
+}
+
+std::shared_ptr<const CachedFile> FileCache::LoadEncoded(const CachedFile &file, const std::string &path,
+                                                         ContentEncoding encoding)
+{
+    std::shared_ptr<CachedFile> encoded = std::make_shared<CachedFile>();
+    encoded->stat_ = file.stat_;
+    encoded->content_type_ = file.content_type_;
+    encoded->last_modified_ = file.last_modified_;
+    encoded->compressible_ = true;
+
+    // 优先使用预先压缩好的同名文件，比原文件旧的视为过期
+    std::string sibling = path + ENCODING_SUFFIXES[encoding];
+    struct stat sibling_stat;
+    if (stat(sibling.c_str(), &sibling_stat) == 0 && S_ISREG(sibling_stat.st_mode) &&
+        (sibling_stat.st_mode & S_IROTH) && sibling_stat.st_mtime >= file.stat_.st_mtime)
+    {
+        encoded->fd_ = open(sibling.c_str(), O_RDONLY | O_CLOEXEC);
+        if (encoded->fd_ >= 0)
+        {
+            encoded->length_ = sibling_stat.st_size;
+            encoded->etag_ = MakeETag(sibling_stat);
+            encoded->headers_ = BuildHeaders(*encoded, encoding);
+            return encoded;
+        }
+    }
+
+    // 不缓存时每个请求都要重新压缩，得不偿失
+    if (max_files_ == 0 || file.length_ < COMPRESS_MIN_SIZE || file.length_ > COMPRESS_MAX_SIZE)
+        return nullptr;
+    std::string content(file.length_, '\0');
+    if (pread(file.fd_, &content[0], content.size(), 0) != (ssize_t)content.size())
+        return nullptr;
+    bool compressed = encoding == ENCODING_GZIP ? Gzip(content, &encoded->data_) : Brotli(content, &encoded->data_);
+    // 压缩后没有变小就直接发送原文件
+    if (!compressed || encoded->data_.size() >= content.size())
+        return nullptr;
+    encoded->length_ = encoded->data_.size();
+    // 压缩结果与原文件语义相同但字节不同，使用弱标签
+    encoded->etag_ = "W/" + file.etag_;
+    encoded->headers_ = BuildHeaders(*encoded, encoding);
+    return encoded;
+}
+
+size_t FileCache::GetSize()
+{
+    std::shared_lock<std::shared_mutex> locker(mutex_);
+    return files_.size();
+}
+
+void FileCache::Invalidate(const std::string &path, bool directory)
+{
+    std::unique_lock<std::shared_mutex> locker(mutex_);
+    if (directory)
+    {
+        // 目录被移动或删除，其下所有文件的路径都已失效
+        std::string prefix = path + "/";
+        for (auto it = files_.begin(); it != files_.end();)
+        {
+            auto next = std::next(it);
+            if (it->first.compare(0, prefix.size(), prefix) == 0)
+                Erase(it);
+            it = next;
+        }
+        return;
+    }
+    auto it = files_.find(path);
+    if (it != files_.end())
+        Erase(it);
+    // 预压缩文件变化时，原文件条目中缓存的变体随之失效
+    for (int encoding = ENCODING_GZIP; encoding < ENCODING_COUNT; ++encoding)
+    {
+        size_t length = strlen(ENCODING_SUFFIXES[encoding]);
+        if (path.size() > length && path.compare(path.size() - length, length, ENCODING_SUFFIXES[encoding]) == 0)
+        {
+            it = files_.find(path.substr(0, path.size() - length));
+            if (it != files_.end())
+                Erase(it);
+        }
+    }
+}
+
+void FileCache::Clear()
+{
+    std::unique_lock<std::shared_mutex> locker(mutex_);
+    files_.clear();
+    clock_.clear();
+    hand_ = clock_.end();
+}
+
+void FileCache::WatchLoop()
+{
+    std::vector<char> buffer(64 * 1024);
+    CoarseClock::Refresh();
+    time_t report_time = CoarseClock::Now() + STATISTICS_INTERVAL;
+    while (!stop_)
+    {
+        CoarseClock::Refresh();
+        if (CoarseClock::Now() >= report_time)
+        {
+            report_time += STATISTICS_INTERVAL;
+            LOG_INFO("file cache: %zu files, %llu hits, %llu misses", GetSize(),
+                     (unsigned long long)hits_, (unsigned long long)misses_);
+        }
+        // 定时醒来检查是否需要退出
+        pollfd event;
+        event.fd = inotify_fd_;
+        event.events = POLLIN;
+        if (poll(&event, 1, 1000) <= 0)
+            continue;
+        ssize_t length = read(inotify_fd_, buffer.data(), buffer.size());
+        for (char *p = buffer.data(); length > 0 && p < buffer.data() + length;)
+        {
+            inotify_event *notify = reinterpret_cast<inotify_event *>(p);
+            p += sizeof(inotify_event) + notify->len;
+            if (notify->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                // 丢失了事件或者目录本身被移走，无法确定哪些条目失效
+                Clear();
+                continue;
+            }
+            if (notify->len == 0)
+                continue;
+            auto dir = watch_dirs_.find(notify->wd);
+            if (dir == watch_dirs_.end())
+                continue;
+            std::string path = dir->second + "/" + notify->name;
+            if ((notify->mask & (IN_CREATE | IN_MOVED_TO)) && (notify->mask & IN_ISDIR))
+                Watch(path);
+            Invalidate(path, notify->mask & IN_ISDIR);
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef HTTP_FILECACHE_H
+#define HTTP_FILECACHE_H
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// 响应正文的内容编码
+enum ContentEncoding
+{
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_BROTLI,
+    ENCODING_COUNT
+};
+
+// 缓存的静态文件：打开的fd、stat结果和预先生成的响应头。
+// 由shared_ptr共享，文件失效后正在发送它的连接仍可用完，最后一个引用释放时关闭fd
+struct CachedFile
+{
+    CachedFile() : fd_(-1), length_(0), content_type_(nullptr), compressible_(false){};
+    ~CachedFile();
+    CachedFile(const CachedFile &) = delete;
+    CachedFile &operator=(const CachedFile &) = delete;
+
+    // 不是可读的普通文件，或者正文是内存中压缩的结果时为-1
+    int fd_;
+    // 原文件的stat结果，压缩变体与原文件相同
+    struct stat stat_;
+    // 响应正文的长度
+    off_t length_;
+    // fd_为-1时的响应正文
+    std::string data_;
+    // 200响应的状态行和实体头部
+    std::string headers_;
+    // HTTP日期格式的修改时间
+    std::string last_modified_;
+    // 由修改时间和长度生成的实体标签，在内存中压缩的变体为弱标签
+    std::string etag_;
+    const char *content_type_;
+    // 是否值得压缩，图片、视频等已压缩的格式为false
+    bool compressible_;
+    // 各编码的变体，首次请求时加载同名的.gz/.br文件或在内存中压缩，失效时随原文件一起丢弃
+    mutable std::once_flag encoded_once_[ENCODING_COUNT];
+    mutable std::shared_ptr<const CachedFile> encoded_[ENCODING_COUNT];
+};
+
+// 以文件的完整路径为键的静态文件缓存，由各工作线程并发访问。
+// 命中只需共享锁；同一文件的并发未命中合并为一次加载，其余线程等待同一个结果。
+// 缓存满时按CLOCK算法淘汰近期未被访问的条目，命中时只设置访问标记，不必获取独占锁。
+// 后台线程通过inotify监视文档根目录，文件被修改、删除或移动时使对应条目失效
+class FileCache
+{
+public:
+    // 采用局部静态对象实现的单例
+    static FileCache *GetInstance()
+    {
+        static FileCache instance;
+        return &instance;
+    }
+
+    // 监视root目录及其子目录，最多缓存max_files个文件
+    bool Initialize(const std::string &root, size_t max_files);
+    // 返回文件的缓存条目，文件不存在时返回nullptr
+    std::shared_ptr<const CachedFile> Get(const std::string &path);
+    // 按br、gzip的顺序返回file在accepted（以1 << ContentEncoding为位）中第一个可用的压缩变体，
+    // 都不可用时返回file本身。path为file的路径
+    std::shared_ptr<const CachedFile> GetEncoded(const std::shared_ptr<const CachedFile> &file,
+                                                 const std::string &path, unsigned accepted);
+
+    uint64_t GetHits() const { return hits_; }
+    uint64_t GetMisses() const { return misses_; }
+    size_t GetSize();
+
+private:
+    typedef std::shared_future<std::shared_ptr<const CachedFile>> Pending;
+    struct Entry
+    {
+        explicit Entry(Pending pending) : pending_(std::move(pending)), referenced_(false) {}
+        Pending pending_;
+        // 时钟指针上次经过后是否被访问过
+        std::atomic<bool> referenced_;
+        // 在时钟环中的位置
+        std::list<std::string>::iterator clock_;
+    };
+    typedef std::unordered_map<std::string, Entry> FileMap;
+
+    FileCache() : hand_(clock_.end()), inotify_fd_(-1), max_files_(0), hits_(0), misses_(0), stop_(false){};
+    ~FileCache();
+    FileCache(const FileCache &) = delete;
+    FileCache &operator=(const FileCache &) = delete;
+
+    static std::shared_ptr<const CachedFile> Load(const std::string &path);
+    // 加载同名的压缩文件，不存在时在内存中压缩原文件
+    std::shared_ptr<const CachedFile> LoadEncoded(const CachedFile &file, const std::string &path,
+                                                  ContentEncoding encoding);
+    // 为目录及其子目录添加inotify监视
+    void Watch(const std::string &dir);
+    // 后台线程：读取inotify事件并使条目失效，定期输出命中统计
+    void WatchLoop();
+    // 使path对应的条目失效，directory为true时使该目录下的所有条目失效
+    void Invalidate(const std::string &path, bool directory);
+    void Clear();
+    // 以下均须持有独占锁：删除一个条目，以及按CLOCK算法淘汰一个条目
+    void Erase(FileMap::iterator it);
+    void EvictOne();
+
+    std::shared_mutex mutex_;
+    // 已加载或正在加载的文件
+    FileMap files_;
+    // 所有条目的键排成的时钟环和时钟指针，新条目插在指针之前，最后才会被检查
+    std::list<std::string> clock_;
+    std::list<std::string>::iterator hand_;
+    // inotify监视描述符对应的目录
+    std::unordered_map<int, std::string> watch_dirs_;
+    int inotify_fd_;
+    size_t max_files_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<bool> stop_;
+    std::thread watcher_;
+};
+
+#endif
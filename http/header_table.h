@@ -0,0 +1,160 @@
+#ifndef HTTP_HEADER_TABLE_H
+#define HTTP_HEADER_TABLE_H
+
+#include <strings.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "scanner.h"
+
+// 已知的请求头，同时是HeaderTable中索引数组的下标
+enum HeaderId
+{
+    HEADER_ACCEPT,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_CONNECTION,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_TYPE,
+    HEADER_COOKIE,
+    HEADER_EXPECT,
+    HEADER_HOST,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_IF_NONE_MATCH,
+    HEADER_IF_RANGE,
+    HEADER_RANGE,
+    HEADER_REFERER,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_USER_AGENT,
+    HEADER_COUNT,
+    HEADER_UNKNOWN = HEADER_COUNT
+};
+
+namespace header_hash
+{
+// 与HeaderId的顺序一致
+constexpr std::string_view NAMES[HEADER_COUNT] = {
+    "Accept", "Accept-Encoding", "Connection", "Content-Length", "Content-Type",
+    "Cookie", "Expect", "Host", "If-Modified-Since", "If-None-Match",
+    "If-Range", "Range", "Referer", "Transfer-Encoding", "User-Agent"};
+
+constexpr int SLOT_BITS = 6;
+constexpr size_t SLOT_COUNT = 1 << SLOT_BITS;
+
+// 字母转小写，其他字符可能被改变，但只影响散列值，最终仍由strncasecmp确认
+constexpr uint32_t Fold(char c) { return static_cast<unsigned char>(c) | 0x20; }
+
+// 以长度和首尾字符作为键，乘以seed后取高SLOT_BITS位
+constexpr size_t Hash(uint32_t seed, const char *name, size_t length)
+{
+    return static_cast<uint32_t>(seed * (Fold(name[0]) ^ (Fold(name[length - 1]) << 8) ^ (length << 16))) >>
+           (32 - SLOT_BITS);
+}
+
+constexpr bool Collides(uint32_t seed)
+{
+    bool used[SLOT_COUNT] = {};
+    for (const std::string_view &name : NAMES)
+    {
+        size_t slot = Hash(seed, name.data(), name.size());
+        if (used[slot])
+            return true;
+        used[slot] = true;
+    }
+    return false;
+}
+
+// 编译期搜索使所有已知字段名互不冲突的乘数
+constexpr uint32_t FindSeed()
+{
+    uint32_t seed = 0x9e3779b1;
+    while (Collides(seed))
+        seed += 2;
+    return seed;
+}
+
+constexpr uint32_t SEED = FindSeed();
+
+constexpr std::array<uint8_t, SLOT_COUNT> BuildSlots()
+{
+    std::array<uint8_t, SLOT_COUNT> slots = {};
+    for (size_t i = 0; i < SLOT_COUNT; ++i)
+        slots[i] = HEADER_UNKNOWN;
+    for (int id = 0; id < HEADER_COUNT; ++id)
+        slots[Hash(SEED, NAMES[id].data(), NAMES[id].size())] = id;
+    return slots;
+}
+
+// 散列槽到HeaderId的映射
+constexpr std::array<uint8_t, SLOT_COUNT> SLOTS = BuildSlots();
+} // namespace header_hash
+
+// 按字段名查找已知的请求头，不区分大小写，一次散列加一次比较
+inline HeaderId LookupHeader(const char *name, size_t length)
+{
+    if (length == 0)
+        return HEADER_UNKNOWN;
+    int id = header_hash::SLOTS[header_hash::Hash(header_hash::SEED, name, length)];
+    if (id == HEADER_UNKNOWN || header_hash::NAMES[id].size() != length ||
+        strncasecmp(header_hash::NAMES[id].data(), name, length) != 0)
+        return HEADER_UNKNOWN;
+    return static_cast<HeaderId>(id);
+}
+
+// 一个请求的全部请求头。字段名和值都指向读缓冲区，不复制；
+// 已知的字段另有按HeaderId的索引，O(1)取值
+class HeaderTable
+{
+public:
+    static const int MAX_FIELDS = 64;
+
+    HeaderTable() { Clear(); }
+
+    void Clear()
+    {
+        count_ = 0;
+        memset(index_, 0, sizeof(index_));
+    }
+    // 记录一个字段并返回其HeaderId。同名的已知字段以最后一个为准，超过MAX_FIELDS的字段不再记录
+    HeaderId Add(const HeaderField &field)
+    {
+        HeaderId id = LookupHeader(field.name_, field.name_length_);
+        if (count_ == MAX_FIELDS)
+            return id;
+        fields_[count_++] = field;
+        if (id != HEADER_UNKNOWN)
+            index_[id] = count_;
+        return id;
+    }
+    // 已知字段的值，以'\0'结尾，请求中没有该字段时返回nullptr
+    char *Value(HeaderId id) const { return index_[id] ? fields_[index_[id] - 1].value_ : nullptr; }
+    std::string_view View(HeaderId id) const
+    {
+        if (!index_[id])
+            return std::string_view();
+        const HeaderField &field = fields_[index_[id] - 1];
+        return std::string_view(field.value_, field.value_length_);
+    }
+    // 按名字线性查找任意字段，用于不在HeaderId中的字段
+    const HeaderField *Find(std::string_view name) const
+    {
+        for (int i = 0; i < count_; ++i)
+        {
+            if (fields_[i].name_length_ == name.size() && strncasecmp(fields_[i].name_, name.data(), name.size()) == 0)
+                return &fields_[i];
+        }
+        return nullptr;
+    }
+    int Count() const { return count_; }
+    const HeaderField &Field(int index) const { return fields_[index]; }
+
+private:
+    HeaderField fields_[MAX_FIELDS];
+    int count_;
+    // 已知字段在fields_中的位置加1，0表示没有
+    uint8_t index_[HEADER_COUNT];
+};
+
+#endif
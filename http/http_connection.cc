@@ -1,8 +1,11 @@
+#include <limits.h>
+
 #include <map>
 #include <fstream>
 #include <mysql/mysql.h>
 
 #include "http_connection.h"
+#include "http/scanner.h"
 #include "logger/logger.h"
 // 配置文件
 #include "config.inc"
@@ -10,19 +13,43 @@
 
 namespace
 {
-// 状态短语和描述
-const char OK_200_TITLE[] = "OK";
-const char ERROR_400_TITLE[] = "Bad Request";
+// 完整的状态行和描述。403、404沿用原来的"Internal Error"短语
+const char OK_200_STATUS[] = "HTTP/1.1 200 OK\r\n";
+const char PARTIAL_206_STATUS[] = "HTTP/1.1 206 Partial Content\r\n";
+const char CREATED_201_STATUS[] = "HTTP/1.1 201 Created\r\n";
+const char NOT_MODIFIED_304_STATUS[] = "HTTP/1.1 304 Not Modified\r\n";
 const char ERROR_400_FORM[] = "Your request has bad syntax or is inherently impossible to staisfy.\n";
-const char ERROR_403_TITLE[] = "Forbidden";
+const char ERROR_403_STATUS[] = "HTTP/1.1 403 Internal Error\r\n";
 const char ERROR_403_FORM[] = "You do not have permission to get file form this server.\n";
-const char ERROR_404_TITLE[] = "Not Found";
+const char ERROR_404_STATUS[] = "HTTP/1.1 404 Internal Error\r\n";
 const char ERROR_404_FORM[] = "The requested file was not found on this server.\n";
-const char ERROR_500_TITLE[] = "Internal Error";
+const char ERROR_416_STATUS[] = "HTTP/1.1 416 Range Not Satisfiable\r\n";
+const char ERROR_500_STATUS[] = "HTTP/1.1 500 Internal Error\r\n";
 const char ERROR_500_FORM[] = "There was an unusual problem serving the request file.\n";
+
+// 把[data, data + length)复制到p，返回复制后的末尾
+char *Copy(char *p, const char *data, size_t length)
+{
+    memcpy(p, data, length);
+    return p + length;
+}
+template <size_t N>
+char *Copy(char *p, const char (&text)[N])
+{
+    return Copy(p, text, N - 1);
+}
+char *CopyDecimal(char *p, unsigned long long value, int width = 1)
+{
+    char buffer[MAX_DECIMAL_DIGITS];
+    char *begin = FormatDecimal(buffer + sizeof(buffer), value, width);
+    return Copy(p, begin, buffer + sizeof(buffer) - begin);
+}
 // html和资源文件路径
 const char doc_root[] = ROOT_PATH;
-std::map<std::string, std::string> users;
+// 登录和注册的CGI程序
+const std::string cgi_program = std::string(doc_root) + "/CGISQL.cgi";
+// std::less<>使登录时可以直接用表单中的string_view查找
+std::map<std::string, std::string, std::less<>> users;
 std::mutex users_locker;
 } // namespace
 
@@ -77,6 +104,15 @@ void HttpConnection::InitResultFile(ConnectPool *conn_pool)
 
 #endif
 
+void HttpConnection::InitFileCache(size_t max_files)
+{
+#ifdef UPLOAD
+    // 上传目录在启动时建好，文件缓存开始监视文档根目录之前就已存在
+    mkdir((std::string(doc_root) + "/upload").c_str(), 0755);
+#endif
+    FileCache::GetInstance()->Initialize(doc_root, max_files);
+}
+
 int SetNonBlock(int fd)
 {
     int old_option = fcntl(fd, F_GETFL);
@@ -121,26 +157,45 @@ void ModFd(int epollfd, int fd, int ev_event)
     epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
 }
 
-int HttpConnection::user_count_ = 0;
-int HttpConnection::epoll_fd_ = -1;
+std::atomic<int> HttpConnection::user_count_(0);
 
-// 关闭连接
+namespace
+{
+// 读缓冲区每个块最后留一个字节，供ParseContent在正文末尾写入'\0'
+const size_t READ_BLOCK_CAPACITY = BUFFER_BLOCK_CAPACITY - 1;
+// 范围请求开始发送时提示内核预读的长度
+const off_t RANGE_READAHEAD = 2 * 1024 * 1024;
+// 多范围响应的分隔符，每个响应取一个新值
+std::atomic<unsigned long long> boundary_counter(0);
+} // namespace
+
+HttpConnection::~HttpConnection()
+{
+    CloseFile();
+    CloseUpload();
+}
+
+// 关闭连接。由工作线程调用，这里只关闭socket的读写，
+// 连接由所属反应堆在收到EPOLLRDHUP后关闭并回收，避免与反应堆线程同时释放连接
 void HttpConnection::CloseConnection(bool real_close)
 {
     if (real_close && (socket_fd_ != -1))
     {
-        RemoveFd(epoll_fd_, socket_fd_);
-        socket_fd_ = -1;
-        --user_count_;
+        shutdown(socket_fd_, SHUT_RDWR);
     }
 }
 
-void HttpConnection::Initialize(int socket_fd, const sockaddr_in &addr)
+void HttpConnection::Initialize(int socket_fd, const sockaddr_in &addr, int epoll_fd)
 {
     socket_fd_ = socket_fd;
     address_ = addr;
+    epoll_fd_ = epoll_fd;
 
-    AddFd(epoll_fd_, socket_fd_, true);
+    // io_uring后端不使用epoll，此时epoll_fd为-1，socket同样设为非阻塞以便直接调用sendfile
+    if (epoll_fd_ != -1)
+        AddFd(epoll_fd_, socket_fd_, true);
+    else
+        SetNonBlock(socket_fd_);
     ++user_count_;
     Initialize();
 }
@@ -148,77 +203,121 @@ void HttpConnection::Initialize(int socket_fd, const sockaddr_in &addr)
 void HttpConnection::Initialize()
 {
     mysql_ = nullptr;
-    bytes_to_send_ = 0;
     bytes_have_send_ = 0;
+    close_after_write_ = false;
+    read_chain_.Clear();
+    write_chain_.Clear();
+    segments_.clear();
+    segment_gaps_ = 0;
+    ResetRequest();
+}
+
+void HttpConnection::ResetRequest()
+{
     check_state_ = CHECK_STATE_REQUESTLINE;
     linger_ = false;
     method_ = GET;
     url_ = nullptr;
+    query_ = nullptr;
     http_version_ = nullptr;
     content_length_ = 0;
-    host_ = nullptr;
+    chunked_ = false;
+    chunk_state_ = CHUNK_SIZE;
+    chunk_size_ = 0;
+    chunk_line_ = 0;
+    chunk_extension_ = false;
+    headers_.Clear();
     start_line_ = 0;
     checked_idx_ = 0;
     read_idx_ = 0;
-    write_idx_ = 0;
     cgi_ = 0;
-    memset(read_buffer_, '\0', READ_BUFFER_SIZE);
-    memset(write_buffer_, '\0', WRITE_BUFFER_SIZE);
-    memset(real_file_, '\0', FILNAME_LEN);
+    string_ = nullptr;
+    passed_ = 0;
+    request_length_ = 0;
+    request_complete_ = false;
+    route_ = nullptr;
+    path_info_ = nullptr;
+    streaming_ = false;
+    body_remaining_ = 0;
+    CloseUpload();
+    file_.reset();
+    range_count_ = 0;
+    accept_encodings_ = 0;
+    // 下一个请求从读缓冲区链头部未消费的位置开始解析
+    read_block_ = nullptr;
+    read_buffer_ = nullptr;
+    if (!body_.empty())
+        std::string().swap(body_);
 }
 
 // 从状态机。负责处理读取缓冲区，将"\r\n"变为"\0\0"，并按读到的字符返回已经读到的状态
 HttpConnection::LineStatus HttpConnection::PraseLine()
 {
     char tmp;
-    for (; checked_idx_ < read_idx_; ++checked_idx_)
+    while (true)
     {
-        tmp = read_buffer_[checked_idx_];
-        if (tmp == '\r')
+        // 行中的普通字符由扫描器成批跳过，只在'\r'或'\n'处停下，以下每个分支都会返回或跳出
+        while ((checked_idx_ = FindLineEnd(read_buffer_ + checked_idx_, read_buffer_ + read_idx_) - read_buffer_) <
+               read_idx_)
         {
-            if ((checked_idx_ + 1) == read_idx_)
+            tmp = read_buffer_[checked_idx_];
+            if (tmp == '\r')
             {
-                // 字符'\r'位于缓冲区结尾，表示接受不完整，需要继续读取
-                return LINE_OPEN;
+                if ((checked_idx_ + 1) == read_idx_)
+                {
+                    // 字符'\r'位于块结尾，表示接受不完整，需要继续读取
+                    break;
+                }
+                else if (read_buffer_[checked_idx_ + 1] == '\n')
+                {
+                    // 读取到了"\r\n"表示读到了请求一行的结尾，将其改为"\0\0",并返回该行状态正常
+                    read_buffer_[checked_idx_++] = '\0';
+                    read_buffer_[checked_idx_++] = '\0';
+                    return LINE_OK;
+                }
+                // '\r'后既不是缓冲区结尾，也不是’\n‘，表示请求格式错误
+                return LINE_BAD;
             }
-            else if (read_buffer_[checked_idx_ + 1] == '\n')
+            else if (tmp == '\n')
             {
-                // 读取到了"\r\n"表示读到了请求一行的结尾，将其改为"\0\0",并返回该行状态正常
-                read_buffer_[checked_idx_++] = '\0';
-                read_buffer_[checked_idx_++] = '\0';
-                return LINE_OK;
+                if (checked_idx_ > 1 && read_buffer_[checked_idx_ - 1] == '\r')
+                {
+                    // 读取到了"\r\n"表示读到了请求一行的结尾，将其改为"\0\0",并返回该行状态正常
+                    read_buffer_[checked_idx_ - 1] = '\0';
+                    read_buffer_[checked_idx_++] = '\0';
+                    return LINE_OK;
+                }
+                // 请求格式错误
+                return LINE_BAD;
             }
-            // '\r'后既不是缓冲区结尾，也不是’\n‘，表示请求格式错误
-            return LINE_BAD;
         }
-        else if (tmp == '\n')
+        if (!read_block_->next_)
         {
-            if (checked_idx_ > 1 && read_buffer_[checked_idx_ - 1] == '\r')
-            {
-                // 读取到了"\r\n"表示读到了请求一行的结尾，将其改为"\0\0",并返回该行状态正常
-                read_buffer_[checked_idx_ - 1] = '\0';
-                read_buffer_[checked_idx_++] = '\0';
-                return LINE_OK;
-            }
-            // 请求格式错误
-            return LINE_BAD;
+            // 没有检测到"\r\n"，表示还应该继续读取
+            return LINE_OPEN;
         }
+        // 本块已写满且后面还有块。未完整的行在追加新块时已经移走，
+        // 这里仍有未完整的行说明该行比一个块还长
+        if (start_line_ < read_idx_)
+            return LINE_BAD;
+        NextReadBlock();
     }
-    // 没有检测到"\r\n"，表示还应该继续读取
-    return LINE_OPEN;
 }
 
 bool HttpConnection::ReadOnce()
 {
-    if (read_idx_ >= READ_BUFFER_SIZE)
-        return false;
+    // 流式正文在读缓冲区链中的部分处理完后，其余部分直接从socket搬到文件
+    if (splice_fd_ >= 0 && body_remaining_ > 0 && read_chain_.Empty())
+        return SpliceBody();
     int bytes_read = 0;
     while (true)
     {
-        bytes_read = recv(socket_fd_,
-                          read_buffer_ + read_idx_,
-                          READ_BUFFER_SIZE - read_idx_,
-                          0);
+        size_t length;
+        char *buffer = ReadSpace(&length, MAX_REQUEST_SIZE);
+        // 已缓存的数据达到上限时先处理已收到的请求，其余数据留在socket中
+        if (!buffer)
+            break;
+        bytes_read = recv(socket_fd_, buffer, length, 0);
         if (bytes_read == -1)
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK)
@@ -227,15 +326,62 @@ bool HttpConnection::ReadOnce()
         }
         else if (bytes_read == 0)
             return false;
-        read_idx_ += bytes_read;
+        read_chain_.Commit(bytes_read);
     }
+    // 没有读到数据，不必继续占用缓冲区
+    if (read_chain_.Empty())
+        read_chain_.Clear();
     return true;
 }
+
+char *HttpConnection::ReadSpace(size_t *length, size_t limit)
+{
+    BufferBlock *tail = read_chain_.Tail();
+    if (!tail || tail->end_ >= READ_BLOCK_CAPACITY)
+    {
+        if (read_chain_.Size() >= limit)
+            return nullptr;
+        tail = read_chain_.AppendBlock(tail ? LineBoundary(tail) : 0);
+        // 正在解析的块可能移走了未完整的行
+        if (read_block_)
+            read_idx_ = read_block_->end_;
+    }
+    *length = READ_BLOCK_CAPACITY - tail->end_;
+    return tail->Data() + tail->end_;
+}
+
+size_t HttpConnection::LineBoundary(BufferBlock *block)
+{
+    // 正文不按行解析，直接跨越块
+    if (check_state_ == CHECK_STATE_CONTENT)
+        return block->end_;
+    // 已解析的行已经把"\r\n"改成了"\0\0"，只需在未解析的部分中找最后一个换行符
+    size_t floor = block == read_block_ ? start_line_ : block->begin_;
+    const char *data = block->Data();
+    for (size_t i = block->end_; i > floor; --i)
+    {
+        if (data[i - 1] == '\n')
+            return i;
+    }
+    // 整个块都是同一行时无法移动，由PraseLine报告该行过长
+    return floor > 0 ? floor : block->end_;
+}
+
+void HttpConnection::NextReadBlock()
+{
+    passed_ += read_block_->end_ - read_block_->begin_;
+    read_block_ = read_block_->next_;
+    read_buffer_ = read_block_->Data();
+    read_idx_ = read_block_->end_;
+    checked_idx_ = 0;
+    start_line_ = 0;
+}
 // 解析请求行，并将方法、url、版本号填入对应成员变量
-HttpConnection::HttpCode HttpConnection::ParseRequestLine(char *text)
+HttpConnection::HttpCode HttpConnection::ParseRequestLine(char *text, size_t length)
 {
-    url_ = strpbrk(text, " \t");
-    if (url_ == nullptr)
+    char *end = text + length;
+    url_ = FindBlank(text, end);
+    if (url_ == end)
     {
         return BAD_REQUEST;
     }
@@ -251,6 +397,13 @@ HttpConnection::HttpCode HttpConnection::ParseRequestLine(char *text)
         method_ = POST;
         cgi_ = 1;
     }
+#ifdef UPLOAD
+    // PUT只用于上传，未编译上传功能时与其他不支持的方法一样拒绝
+    else if (strcasecmp(method, "PUT") == 0)
+    {
+        method_ = PUT;
+    }
+#endif
     else
     {
         return BAD_REQUEST;
@@ -258,8 +411,8 @@ HttpConnection::HttpCode HttpConnection::ParseRequestLine(char *text)
     // 跳过空格，生成真正的url
     url_ += strspn(url_, " \t");
     // 用生成url的方法生成http版本号
-    http_version_ = strpbrk(url_, " \t");
-    if (!http_version_)
+    http_version_ = FindBlank(url_, end);
+    if (http_version_ == end)
         return BAD_REQUEST;
     *http_version_++ = '\0';
     http_version_ += strspn(http_version_, " \t");
@@ -282,71 +435,321 @@ HttpConnection::HttpCode HttpConnection::ParseRequestLine(char *text)
     {
         return BAD_REQUEST;
     }
-    // 初始页面
-    if (strlen(url_) == 1)
-        strcat(url_, "judge.html");
+    // 查询串不属于路径，原样保留；路径解码%xx并去掉"."和".."段，越过根目录的请求直接拒绝
+    char *url_end = url_ + strlen(url_);
+    char *query = const_cast<char *>(FindFirstOf(url_, url_end, '?', '#'));
+    if (query < url_end)
+    {
+        query_ = *query == '?' ? query + 1 : nullptr;
+        *query = '\0';
+        url_end = query;
+    }
+    url_end = CanonicalizePath(url_, url_end);
+    if (!url_end)
+        return BAD_REQUEST;
+    *url_end = '\0';
     // 请求行读取完毕，将状态重置为CHECK_STATE_HEADER，下一步解析请求头
     check_state_ = CHECK_STATE_HEADER;
     return NO_REQUEST;
 }
 
 // 解析请求头，填入对应成员
-HttpConnection::HttpCode HttpConnection::ParseHeaders(char *text)
+HttpConnection::HttpCode HttpConnection::ParseHeaders(char *text, size_t length)
 {
-    if (text[0] == '\0')
+    if (length == 0)
     {
-        // 空行，表示请求头结束，下一步该切换主状态机状态以读取正文
-        if (content_length_ != 0)
+        // 空行，表示请求头结束，先确定路由，下一步该切换主状态机状态以读取正文
+        route_ = Routes().Find(method_, url_, strlen(url_), &path_info_);
+        // PUT只能交给接收正文的路由（上传），不能落到按静态文件处理的路由或文档根目录上
+        if (method_ == PUT && !(route_ && route_->body_handler_))
+            return BAD_REQUEST;
+        if (content_length_ != 0 || chunked_)
         {
             // 正文长度非零，表示是POST请求，需要继续读取
             check_state_ = CHECK_STATE_CONTENT;
+            if (route_ && route_->body_handler_)
+            {
+                // 路由逐段处理正文，正文长度只受路由自己的限制
+                streaming_ = true;
+                body_remaining_ = chunked_ ? 0 : content_length_;
+                return (this->*route_->body_handler_)(route_->target_, nullptr, 0);
+            }
+            // 整体缓存的正文不能超过一个请求的长度上限
+            if (!chunked_ && content_length_ > MAX_REQUEST_SIZE)
+                return BAD_REQUEST;
             return NO_REQUEST;
         }
         // 否则为GET请求
         return GET_REQUEST;
     }
-    else if (strncasecmp(text, "Connection:", 11) == 0)
+    // 字段名和去掉空白的值一次拆分出来
+    HeaderField field;
+    if (!SplitHeaderField(text, length, &field))
+        return BAD_REQUEST;
+    // 所有字段都记入请求头表，只有影响解析的字段在这里处理，其余的由DoRequest按需取值
+    char *value = field.value_;
+    switch (headers_.Add(field))
     {
-        text += 11;
-        // 跳过空格和'\t'
-        text += strspn(text, " \t");
-        if (strcasecmp(text, "keep-alive") == 0)
+    case HEADER_CONNECTION:
+    {
+        if (strcasecmp(value, "keep-alive") == 0)
         {
             // keep-alive表示为持续链接，linger_字段应设置为True
             linger_ = true;
         }
+        break;
     }
-    else if (strncasecmp(text, "Content-length:", 15) == 0)
+    case HEADER_CONTENT_LENGTH:
     {
-        // 解析正文长度
-        text += 15;
-        text += strspn(text, "\t");
         // 正文长度关系到GET还是POST请求
-        content_length_ = atoi(text);
+        char *end = nullptr;
+        content_length_ = strtoll(value, &end, 10);
+        if (end == value || *end != '\0' || content_length_ < 0)
+            return BAD_REQUEST;
+        break;
     }
-    else if (strncasecmp(text, "Host:", 5) == 0)
+    case HEADER_TRANSFER_ENCODING:
     {
-        text += 5;
-        text += strspn(text, " \t");
-        host_ = text;
+        // 只支持以chunked结尾的传输编码，同时出现Content-Length时以分块编码为准
+        size_t value_length = field.value_length_;
+        if (value_length < 7 || strncasecmp(value + value_length - 7, "chunked", 7) != 0 ||
+            (value_length > 7 && !strchr(", \t", value[value_length - 8])))
+            return BAD_REQUEST;
+        chunked_ = true;
+        break;
     }
-    else
+    case HEADER_ACCEPT_ENCODING:
     {
-        LOG_INFO("Unknow header: %s", text);
-        Logger::GetInstance()->Flush();
+        // 逐个取出编码名，q=0表示明确拒绝该编码。strtok_r会改写值，之后不能再从请求头表中读取它
+        char *save = nullptr;
+        for (char *coding = strtok_r(value, ",", &save); coding; coding = strtok_r(nullptr, ",", &save))
+        {
+            coding += strspn(coding, " \t");
+            size_t coding_length = strcspn(coding, " \t;");
+            const char *quality = strstr(coding + coding_length, "q=");
+            if (quality && atof(quality + 2) == 0)
+                continue;
+            if ((coding_length == 4 && strncasecmp(coding, "gzip", 4) == 0) || (coding_length == 1 && coding[0] == '*'))
+                accept_encodings_ |= 1u << ENCODING_GZIP;
+            else if (coding_length == 2 && strncasecmp(coding, "br", 2) == 0)
+                accept_encodings_ |= 1u << ENCODING_BROTLI;
+        }
+        break;
+    }
+    default:
+        // 未知字段只占请求头表的一项，不再写日志
+        break;
     }
     return NO_REQUEST;
 }
 
 HttpConnection::HttpCode HttpConnection::ParseContent(char *text)
 {
-    if (read_idx_ >= (content_length_ + checked_idx_))
+    if (chunked_)
+        return ParseChunked();
+    if (streaming_)
+        return StreamContent();
+    // 请求头恰好在块的末尾结束，正文从下一个块开始
+    if (checked_idx_ == read_idx_ && read_block_->next_)
+    {
+        NextReadBlock();
+        text = GetLine();
+    }
+    // 正文全部在当前块内且恰好在块尾结束时直接引用，
+    // 后面还有流水线中的下一个请求时不能在正文末尾写入'\0'，复制一份
+    if (read_idx_ == (content_length_ + checked_idx_))
     {
         text[content_length_] = '\0';
         string_ = text;
         return GET_REQUEST;
     }
-    return NO_REQUEST;
+    if (read_idx_ > (content_length_ + checked_idx_))
+    {
+        body_.assign(text, content_length_);
+        string_ = &body_[0];
+        return GET_REQUEST;
+    }
+    // 正文跨越多个块，收齐后拼接成连续的字符串
+    size_t length = content_length_;
+    size_t received = read_idx_ - checked_idx_;
+    for (BufferBlock *block = read_block_->next_; block; block = block->next_)
+        received += block->end_;
+    if (received < length)
+        return NO_REQUEST;
+    body_.assign(text, read_idx_ - checked_idx_);
+    for (BufferBlock *block = read_block_->next_; body_.size() < length; block = block->next_)
+    {
+        size_t count = length - body_.size();
+        body_.append(block->Data(), count < block->end_ ? count : block->end_);
+    }
+    string_ = &body_[0];
+    return GET_REQUEST;
+}
+HttpConnection::HttpCode HttpConnection::StreamContent()
+{
+    while (body_remaining_ > 0)
+    {
+        if (checked_idx_ == read_idx_)
+        {
+            if (!read_block_->next_)
+                return NO_REQUEST;
+            NextReadBlock();
+            continue;
+        }
+        size_t count = read_idx_ - checked_idx_;
+        if ((long long)count > body_remaining_)
+            count = body_remaining_;
+        HttpCode ret = (this->*route_->body_handler_)(route_->target_, read_buffer_ + checked_idx_, count);
+        if (ret != NO_REQUEST)
+            return ret;
+        checked_idx_ += count;
+        body_remaining_ -= count;
+    }
+    return GET_REQUEST;
+}
+
+void HttpConnection::ReleaseParsed()
+{
+    // 请求行和请求头也在释放的部分中，之后不能再访问url_和请求头表
+    read_chain_.Consume(passed_ + checked_idx_ - read_block_->begin_);
+    if (read_chain_.Empty())
+        read_chain_.Clear();
+    headers_.Clear();
+    url_ = nullptr;
+    query_ = nullptr;
+    path_info_ = nullptr;
+    passed_ = 0;
+    read_block_ = nullptr;
+    read_buffer_ = nullptr;
+}
+
+bool HttpConnection::SpliceBody()
+{
+    if (pipe_fd_[0] < 0 && pipe2(pipe_fd_, O_NONBLOCK | O_CLOEXEC) < 0)
+        return false;
+    while (body_remaining_ > 0)
+    {
+        size_t length = body_remaining_ < SPLICE_SIZE ? body_remaining_ : SPLICE_SIZE;
+        ssize_t received = splice(socket_fd_, nullptr, pipe_fd_[1], nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (received == 0)
+            return false;
+        if (received < 0)
+        {
+            // 管道每次都会排空，EAGAIN只能是socket中暂时没有数据
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        // 管道中的数据全部写入文件后再接收下一段，文件写入出错时只能关闭连接
+        for (ssize_t left = received; left > 0;)
+        {
+            ssize_t written = splice(pipe_fd_[0], nullptr, splice_fd_, nullptr, left, SPLICE_F_MOVE);
+            if (written <= 0)
+                return false;
+            left -= written;
+        }
+        body_remaining_ -= received;
+    }
+    return true;
+}
+
+HttpConnection::HttpCode HttpConnection::ParseChunked()
+{
+    while (true)
+    {
+        if (checked_idx_ == read_idx_)
+        {
+            if (!read_block_->next_)
+                return NO_REQUEST;
+            NextReadBlock();
+            continue;
+        }
+        char c = read_buffer_[checked_idx_];
+        switch (chunk_state_)
+        {
+        case CHUNK_SIZE:
+        {
+            ++checked_idx_;
+            if (c == '\n')
+            {
+                if (chunk_line_ == 0)
+                    return BAD_REQUEST;
+                chunk_state_ = chunk_size_ == 0 ? CHUNK_TRAILER : CHUNK_DATA;
+                chunk_line_ = 0;
+                chunk_extension_ = false;
+            }
+            else if (c == ';')
+            {
+                // 块扩展直接忽略
+                chunk_extension_ = true;
+            }
+            else if (!chunk_extension_ && c != '\r' && c != ' ' && c != '\t')
+            {
+                if (!isxdigit(c) || chunk_line_ >= MAX_CHUNK_SIZE_DIGITS)
+                    return BAD_REQUEST;
+                chunk_size_ = chunk_size_ * 16 + (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+                ++chunk_line_;
+                // 解码后缓存的正文同样受请求长度的限制
+                if (!streaming_ && body_.size() + chunk_size_ > (size_t)MAX_REQUEST_SIZE)
+                    return BAD_REQUEST;
+            }
+            break;
+        }
+        case CHUNK_DATA:
+        {
+            size_t count = read_idx_ - checked_idx_;
+            if (count > chunk_size_)
+                count = chunk_size_;
+            if (streaming_)
+            {
+                HttpCode ret = (this->*route_->body_handler_)(route_->target_, read_buffer_ + checked_idx_, count);
+                if (ret != NO_REQUEST)
+                    return ret;
+            }
+            else
+            {
+                body_.append(read_buffer_ + checked_idx_, count);
+            }
+            checked_idx_ += count;
+            chunk_size_ -= count;
+            if (chunk_size_ == 0)
+                chunk_state_ = CHUNK_DATA_END;
+            break;
+        }
+        case CHUNK_DATA_END:
+        {
+            ++checked_idx_;
+            if (c == '\n')
+                chunk_state_ = CHUNK_SIZE;
+            else if (c != '\r')
+                return BAD_REQUEST;
+            break;
+        }
+        case CHUNK_TRAILER:
+        {
+            // 尾部字段不使用，遇到空行表示正文结束
+            ++checked_idx_;
+            if (c == '\n')
+            {
+                if (chunk_line_ == 0)
+                {
+                    if (!streaming_)
+                    {
+                        content_length_ = body_.size();
+                        string_ = &body_[0];
+                    }
+                    return GET_REQUEST;
+                }
+                chunk_line_ = 0;
+            }
+            else if (c != '\r')
+            {
+                ++chunk_line_;
+            }
+            break;
+        }
+        }
+    }
 }
 //
 HttpConnection::HttpCode HttpConnection::ProcessRead()
@@ -354,23 +757,44 @@ HttpConnection::HttpCode HttpConnection::ProcessRead()
     LineStatus status = LINE_OK;
     HttpCode ret_code = NO_REQUEST;
     char *text = nullptr;
+    if (!read_block_)
+    {
+        read_block_ = read_chain_.Head();
+        if (!read_block_)
+        {
+            // 用splice接收的正文不经过读缓冲区链，收齐后链中可能没有任何数据
+            if (streaming_ && !chunked_ && body_remaining_ == 0)
+            {
+                request_complete_ = true;
+                return DoRequest();
+            }
+            return NO_REQUEST;
+        }
+        read_buffer_ = read_block_->Data();
+        // 前面的请求已从块头部消费掉
+        checked_idx_ = start_line_ = read_block_->begin_;
+    }
+    // 上次解析后可能又收到了数据
+    read_idx_ = read_block_->end_;
     /*  两种情况会继续解析请求 :
    ①主状态机正在解析请求正文（只有POST方法才会）
    且从状态机状态正常（GET方法此时已经将状态置为LINE_OPEN） 
-   ②从状态机状态正常（主状态机解析请求行和请求头） */
+   ②从状态机状态正常（主状态机解析请求行和请求头）
+   正文不按行解析，正文未收齐时不能让从状态机扫描正文 */
     while ((check_state_ == CHECK_STATE_CONTENT && status == LINE_OK) ||
-           (status = PraseLine()) == LINE_OK)
+           (check_state_ != CHECK_STATE_CONTENT && (status = PraseLine()) == LINE_OK))
     {
         text = GetLine();
+        // 行尾的"\r\n"已改为"\0\0"，不计入行的长度
+        size_t length = check_state_ == CHECK_STATE_CONTENT ? 0 : checked_idx_ - start_line_ - 2;
         start_line_ = checked_idx_;
-        LOG_INFO("%s", text);
-        Logger::GetInstance()->Flush();
+        // 请求行和请求头不逐行写日志，格式化和刷新日志的开销远大于解析本身
         switch (check_state_)
         {
         // 解析请求行
         case CHECK_STATE_REQUESTLINE:
         {
-            ret_code = ParseRequestLine(text);
+            ret_code = ParseRequestLine(text, length);
             if (ret_code == BAD_REQUEST)
                 return BAD_REQUEST;
             break;
@@ -378,14 +802,17 @@ HttpConnection::HttpCode HttpConnection::ProcessRead()
         // 解析请求头
         case CHECK_STATE_HEADER:
         {
-            ret_code = ParseHeaders(text);
-            if (ret_code == BAD_REQUEST)
-                return BAD_REQUEST;
-            else if (ret_code == GET_REQUEST)
+            ret_code = ParseHeaders(text, length);
+            if (ret_code == GET_REQUEST)
             {
                 // 在解析到GET请求后，调用DoRequest生成响应
+                request_length_ = passed_ + checked_idx_ - read_block_->begin_;
+                request_complete_ = true;
                 return DoRequest();
             }
+            // 请求头错误，或者正文处理函数拒绝了请求
+            if (ret_code != NO_REQUEST)
+                return ret_code;
             break;
         }
         case CHECK_STATE_CONTENT:
@@ -393,9 +820,18 @@ HttpConnection::HttpCode HttpConnection::ProcessRead()
             ret_code = ParseContent(text);
             if (ret_code == GET_REQUEST)
             {
-                // ParseContent返回值为GET_REQUEST表示读取到POST请求，应调用DoRequest生成响应
+                // ParseContent返回值为GET_REQUEST表示读取到POST请求，应调用DoRequest生成响应。
+                // 分块编码和流式的正文解析时已越过整个正文
+                request_length_ = passed_ + checked_idx_ - read_block_->begin_ +
+                                  (chunked_ || streaming_ ? 0 : content_length_);
+                request_complete_ = true;
                 return DoRequest();
             }
+            if (ret_code != NO_REQUEST)
+                return ret_code;
+            // 流式正文已交给处理函数的部分不必再缓存
+            if (streaming_)
+                ReleaseParsed();
             // GET请求，解析完正文后为了避免继续循环，要更新状态
             status = LINE_OPEN;
             break;
@@ -406,6 +842,9 @@ HttpConnection::HttpCode HttpConnection::ProcessRead()
         }
         }
     }
+    // 请求行或请求头格式错误，或者某一行超过了一个块的长度
+    if (status == LINE_BAD)
+        return BAD_REQUEST;
     return NO_REQUEST;
 }
 
@@ -416,7 +855,7 @@ bool HttpConnection::ProcessWrite(HttpCode ret)
     {
     case INTERNAL_ERROR:
     {
-        AddStatusLine(500, ERROR_500_TITLE);
+        AddStatusLine(ERROR_500_STATUS);
         AddHeader(strlen(ERROR_500_FORM));
         if (!AddContent(ERROR_500_FORM))
             return false;
@@ -424,7 +863,7 @@ bool HttpConnection::ProcessWrite(HttpCode ret)
     }
     case BAD_REQUEST:
     {
-        AddStatusLine(404, ERROR_500_TITLE);
+        AddStatusLine(ERROR_404_STATUS);
         AddHeader(strlen(ERROR_404_FORM));
         if (!AddContent(ERROR_404_FORM))
             return false;
@@ -432,7 +871,7 @@ bool HttpConnection::ProcessWrite(HttpCode ret)
     }
     case FORBIDDEN_REQUEST:
     {
-        AddStatusLine(403, ERROR_500_TITLE);
+        AddStatusLine(ERROR_403_STATUS);
         AddHeader(strlen(ERROR_403_FORM));
         if (!AddContent(ERROR_403_FORM))
             return false;
@@ -440,366 +879,818 @@ bool HttpConnection::ProcessWrite(HttpCode ret)
     }
     case FILE_REQUEST:
     {
-        AddStatusLine(200, OK_200_TITLE);
-        if (file_stat_.st_size != 0)
+        if (file_->length_ != 0)
         {
-            AddHeader(file_stat_.st_size);
-            iv_[0].iov_base = write_buffer_;
-            iv_[1].iov_base = file_address_;
-            iv_[0].iov_len = write_idx_;
-            iv_[1].iov_len = file_stat_.st_size;
-            iv_count_ = 2;
-            bytes_to_send_ = write_idx_ + file_stat_.st_size;
+            // 状态行和实体头部已由文件缓存生成好，这里只补上连接相关的部分
+            AddResponse(file_->headers_);
+            AddDate();
+            AddLinger();
+            AddBlankLine();
+            // 正文紧跟在响应头之后发送
+            PushBody(0, file_->length_);
             return true;
         }
         else
         {
             const char ok_string[] = "<html><body></body></html>";
+            AddStatusLine(OK_200_STATUS);
             AddHeader(strlen(ok_string));
             if (!AddContent(ok_string))
                 return false;
         }
+        break;
+    }
+    case PARTIAL_REQUEST:
+    {
+        AddStatusLine(PARTIAL_206_STATUS);
+        off_t length = 0;
+        unsigned long long boundary = 0;
+        char part[256];
+        if (range_count_ == 1)
+        {
+            const ByteRange &range = ranges_[0];
+            length = range.last_ - range.first_ + 1;
+            AddResponse("Content-Range: bytes ");
+            AddNumber(range.first_);
+            AddResponse("-");
+            AddNumber(range.last_);
+            AddResponse("/");
+            AddNumber(file_->length_);
+            AddResponse("\r\nContent-Type:");
+            AddContent(file_->content_type_);
+            AddBlankLine();
+        }
+        else
+        {
+            // multipart/byteranges：每个范围前是分隔头，最后是结束分隔符
+            boundary = ++boundary_counter;
+            for (int i = 0; i < range_count_; ++i)
+                length += RangePartHeader(i, boundary, part) + ranges_[i].last_ - ranges_[i].first_ + 1;
+            // 结束分隔符"\r\n--boundary--\r\n"
+            length += 4 + 20 + 4;
+            AddResponse("Content-Type:multipart/byteranges; boundary=");
+            AddResponse(part, CopyDecimal(part, boundary, 20) - part);
+            AddBlankLine();
+        }
+        AddContentLength(length);
+        // 与200响应相同的验证器，缓存和If-Range据此把部分内容与完整的文件对应起来
+        AddResponse("Last-Modified: ");
+        AddResponse(file_->last_modified_);
+        AddResponse("\r\nETag: ");
+        AddResponse(file_->etag_);
+        AddResponse("\r\nAccept-Ranges: bytes\r\n");
+        if (file_->compressible_)
+            AddResponse("Vary: Accept-Encoding\r\n");
+        AddLinger();
+        AddBlankLine();
+        if (range_count_ == 1)
+        {
+            PushBody(ranges_[0].first_, ranges_[0].last_ + 1);
+            return true;
+        }
+        // 各部分的分隔头写入写缓冲区链，范围本身作为正文部分穿插其间
+        for (int i = 0; i < range_count_; ++i)
+        {
+            int part_length = RangePartHeader(i, boundary, part);
+            write_chain_.Append(part, part_length);
+            PushBody(ranges_[i].first_, ranges_[i].last_ + 1);
+        }
+        char *end = Copy(part, "\r\n--");
+        end = CopyDecimal(end, boundary, 20);
+        end = Copy(end, "--\r\n");
+        write_chain_.Append(part, end - part);
+        return true;
+    }
+    case CREATED_REQUEST:
+    {
+        AddStatusLine(CREATED_201_STATUS);
+        if (!AddHeader(0))
+            return false;
+        break;
+    }
+    case DYNAMIC_REQUEST:
+        // 响应已由处理函数生成
+        break;
+    case NOT_MODIFIED:
+    {
+        // 只有状态行和验证器，没有正文
+        AddStatusLine(NOT_MODIFIED_304_STATUS);
+        AddResponse("ETag: ");
+        AddResponse(file_->etag_);
+        AddResponse("\r\nLast-Modified: ");
+        AddResponse(file_->last_modified_);
+        AddBlankLine();
+        if (file_->compressible_)
+            AddResponse("Vary: Accept-Encoding\r\n");
+        AddLinger();
+        if (!AddBlankLine())
+            return false;
+        break;
+    }
+    case RANGE_NOT_SATISFIABLE:
+    {
+        AddStatusLine(ERROR_416_STATUS);
+        AddResponse("Content-Range: bytes */");
+        AddNumber(file_->length_);
+        AddBlankLine();
+        if (!AddHeader(0))
+            return false;
+        break;
     }
     default:
         return false;
     }
-    iv_[0].iov_base = write_buffer_;
-    iv_[0].iov_len = write_idx_;
-    iv_count_ = 1;
-    bytes_to_send_ = write_idx_;
     return true;
 }
 
-HttpConnection::HttpCode HttpConnection::DoRequest()
+HttpConnection::HttpCode HttpConnection::ParseRange()
 {
-    strcpy(real_file_, doc_root);
-    int len = strlen(doc_root);
-    // 查找最后一个'/'字符
-    const char *p = strrchr(url_, '/');
-
-    // 登录或注册
-    if (cgi_ == 1 && (*(p + 1) == '2' || *(p + 1) == '3'))
-    {
-        auto real_url = new char[200];
-        char flag = url_[1];
-        strcpy(real_url, "/");
-        strcat(real_url, url_ + 2);
-        strncpy(real_file_ + len, real_url, FILNAME_LEN - len - 1);
-        delete real_url;
-
-        // 提取用户名、密码
-        std::string name, passwd;
-        int i, j;
-        for (i = 5; string_[i] != '&'; ++i)
-            name += string_[i];
-        for (i = i + 10; string_[i] != '\0'; ++i, ++j)
-            passwd += string_[i];
-
-#ifdef SYNSQL
-        // 如果为注册
-        if (*(p + 1) == '3')
+    char *range = headers_.Value(HEADER_RANGE);
+    if (strncasecmp(range, "bytes=", 6) != 0)
+        return FILE_REQUEST;
+    off_t size = file_->length_;
+    range_count_ = 0;
+    char *save = nullptr;
+    for (char *spec = strtok_r(range + 6, ",", &save); spec; spec = strtok_r(nullptr, ",", &save))
+    {
+        spec += strspn(spec, " \t");
+        char *end = nullptr;
+        off_t first, last;
+        if (*spec == '-')
         {
-            std::string inserter = "INSERT INTO user(username, passwd) VALUES('" + name + "', '" + passwd + "')";
-            if (users.find(name) == users.end())
-            {
-                int res = 0;
-                {
-                    std::lock_guard<std::mutex> locker(users_locker);
-                    res = mysql_query(mysql_, inserter.c_str());
-                    users.insert({name, passwd});
-                }
-                if (!res)
-                    strcpy(url_, "/log.html");
-                else
-                {
-                    strcpy(url_, "/registerError.html");
-                }
-            }
-            else
+            // "-n"表示最后n个字节
+            if (!isdigit(spec[1]))
+                return FILE_REQUEST;
+            off_t suffix = strtoll(spec + 1, &end, 10);
+            if (suffix == 0)
+                continue;
+            first = suffix < size ? size - suffix : 0;
+            last = size - 1;
+        }
+        else
+        {
+            // "first-last"或"first-"
+            if (!isdigit(spec[0]))
+                return FILE_REQUEST;
+            first = strtoll(spec, &end, 10);
+            if (*end++ != '-')
+                return FILE_REQUEST;
+            last = size - 1;
+            if (isdigit(*end))
             {
-                strcpy(url_, "/registerError.html");
+                off_t requested = strtoll(end, &end, 10);
+                if (requested < first)
+                    return FILE_REQUEST;
+                if (requested < last)
+                    last = requested;
             }
         }
-        else if (*(p + 1) == '2')
+        if (end[strspn(end, " \t")] != '\0')
+            return FILE_REQUEST;
+        // 起点超出文件长度的范围无法满足
+        if (first >= size)
+            continue;
+        if (range_count_ == MAX_RANGES)
+            return FILE_REQUEST;
+        ranges_[range_count_].first_ = first;
+        ranges_[range_count_].last_ = last;
+        ++range_count_;
+    }
+    return range_count_ == 0 ? RANGE_NOT_SATISFIABLE : PARTIAL_REQUEST;
+}
+
+bool HttpConnection::IfRangeMatches() const
+{
+    // If-Range要求强比较，弱标签不匹配
+    const char *if_range = headers_.Value(HEADER_IF_RANGE);
+    if (if_range[0] == '"' || strncmp(if_range, "W/", 2) == 0)
+        return strcmp(if_range, file_->etag_.c_str()) == 0 && strncmp(if_range, "W/", 2) != 0;
+    return strcmp(if_range, file_->last_modified_.c_str()) == 0;
+}
+
+bool HttpConnection::NotModified() const
+{
+    // 有If-None-Match时忽略If-Modified-Since
+    const char *if_none_match = headers_.Value(HEADER_IF_NONE_MATCH);
+    const char *if_modified_since = headers_.Value(HEADER_IF_MODIFIED_SINCE);
+    if (if_none_match)
+    {
+        if (strcmp(if_none_match, "*") == 0)
+            return true;
+        // 弱比较：去掉W/前缀后逐个比较标签
+        const char *etag = file_->etag_.c_str();
+        if (strncmp(etag, "W/", 2) == 0)
+            etag += 2;
+        size_t etag_length = strlen(etag);
+        for (const char *p = if_none_match; *p;)
         {
-            if (users.find(name) != users.end() && users[name] == passwd)
-                strcpy(url_, "/welcome.html");
-            else
-                strcpy(url_, "/logError.html");
+            p += strspn(p, " \t,");
+            if (strncmp(p, "W/", 2) == 0)
+                p += 2;
+            size_t length = strcspn(p, " \t,");
+            if (length == etag_length && strncmp(p, etag, length) == 0)
+                return true;
+            p += length;
         }
+        return false;
+    }
+    if (if_modified_since)
+    {
+        struct tm since;
+        memset(&since, 0, sizeof(since));
+        const char *end = strptime(if_modified_since, "%a, %d %b %Y %H:%M:%S GMT", &since);
+        return end && *end == '\0' && file_->stat_.st_mtime <= timegm(&since);
+    }
+    return false;
+}
+
+int HttpConnection::RangePartHeader(int index, unsigned long long boundary, char *buffer) const
+{
+    char *p = Copy(buffer, "\r\n--");
+    p = CopyDecimal(p, boundary, 20);
+    p = Copy(p, "\r\nContent-Type: ");
+    p = Copy(p, file_->content_type_, strlen(file_->content_type_));
+    p = Copy(p, "\r\nContent-Range: bytes ");
+    p = CopyDecimal(p, ranges_[index].first_);
+    p = Copy(p, "-");
+    p = CopyDecimal(p, ranges_[index].last_);
+    p = Copy(p, "/");
+    p = CopyDecimal(p, file_->length_);
+    p = Copy(p, "\r\n\r\n");
+    return p - buffer;
+}
+
+void HttpConnection::PushBody(off_t offset, off_t end)
+{
+    BodySegment segment;
+    segment.file_ = file_;
+    segment.offset_ = offset;
+    segment.end_ = end;
+    segment.gap_ = write_chain_.Size() - segment_gaps_;
+    segment_gaps_ += segment.gap_;
+    segments_.push_back(std::move(segment));
+    // 从文件中间开始的范围不在顺序预读的窗口内，先让内核异步读入开头的一段
+    if (offset > 0 && file_->fd_ >= 0)
+    {
+        off_t length = end - offset;
+        posix_fadvise(file_->fd_, offset, length < RANGE_READAHEAD ? length : RANGE_READAHEAD,
+                      POSIX_FADV_WILLNEED);
+    }
+}
+
+HttpConnection::HttpCode HttpConnection::DoRequest()
+{
+    // 路由在请求头收齐时已经确定，没有匹配的url按文档根目录下的静态文件处理
+    if (route_)
+        return (this->*route_->handler_)(route_->target_);
+    std::string real_file(doc_root);
+    real_file.append(url_, strnlen(url_, FILNAME_LEN - real_file.size() - 1));
+    return ServeFile(real_file);
+}
+
+const HttpConnection::RouteTable &HttpConnection::Routes()
+{
+    // 首次请求时建立，之后各线程只读
+    static const RouteTable routes = [] {
+        std::string root(doc_root);
+        const unsigned any = ~0u;
+        RouteTable table;
+        table.Add(any, "/", &HttpConnection::DoStatic, {root + "/judge.html"});
+        table.Add(any, "/0", &HttpConnection::DoStatic, {root + "/register.html"});
+        table.Add(any, "/1", &HttpConnection::DoStatic, {root + "/log.html"});
+        table.Add(any, "/5", &HttpConnection::DoStatic, {root + "/picture.html"});
+        table.Add(any, "/6", &HttpConnection::DoStatic, {root + "/video.html"});
+        table.Add(any, "/7", &HttpConnection::DoStatic, {root + "/webbench.html"});
+        // 登录成功转到欢迎页，注册成功转到登录页
+        table.Add(1u << POST, "/2CGISQL.cgi", &HttpConnection::DoSign, {root + "/welcome.html", root + "/logError.html"});
+        table.Add(1u << POST, "/3CGISQL.cgi", &HttpConnection::DoSign, {root + "/log.html", root + "/registerError.html"});
+        table.Add(1u << GET, "/status", &HttpConnection::DoStatus, {std::string()});
+#ifdef UPLOAD
+        // 上传的文件保存在文档根目录下的upload目录，之后可以作为静态文件访问
+        table.AddPrefix((1u << PUT) | (1u << POST), "/upload/", &HttpConnection::DoUpload, {root + "/upload"},
+                        &HttpConnection::ReceiveUpload);
 #endif
+        return table;
+    }();
+    return routes;
+}
 
-#ifdef CGISQLPOOL
-        if (*(p + 1) == '3')
+HttpConnection::HttpCode HttpConnection::DoStatic(const RouteTarget &target)
+{
+    return ServeFile(target.path_);
+}
+
+HttpConnection::HttpCode HttpConnection::DoStatus(const RouteTarget &)
+{
+    // 正文的长度事先未知，每生成一行就作为一个块写入，不必先拼出整个页面
+    AddStatusLine(OK_200_STATUS);
+    AddResponse("Cache-Control: no-store\r\n");
+    AddChunkedHeader();
+    const char head[] = "<html><body><h1>Server status</h1><table>\n";
+    AddChunk(head, sizeof(head) - 1);
+    AddStatusRow("connections", user_count_.load(std::memory_order_relaxed));
+    FileCache *cache = FileCache::GetInstance();
+    AddStatusRow("cached files", cache->GetSize());
+    AddStatusRow("cache hits", cache->GetHits());
+    AddStatusRow("cache misses", cache->GetMisses());
+    size_t user_number;
+    {
+        std::lock_guard<std::mutex> locker(users_locker);
+        user_number = users.size();
+    }
+    AddStatusRow("registered users", user_number);
+    const char tail[] = "</table></body></html>\n";
+    AddChunk(tail, sizeof(tail) - 1);
+    AddLastChunk();
+    return DYNAMIC_REQUEST;
+}
+
+void HttpConnection::AddStatusRow(const char *name, unsigned long long value)
+{
+    char row[128];
+    char *end = Copy(row, "<tr><td>");
+    end = Copy(end, name, strnlen(name, 64));
+    end = Copy(end, "</td><td>");
+    end = CopyDecimal(end, value);
+    end = Copy(end, "</td></tr>\n");
+    AddChunk(row, end - row);
+}
+
+HttpConnection::HttpCode HttpConnection::DoSign(const RouteTarget &target)
+{
+    // 路由保证url为"/2CGISQL.cgi"（登录）或"/3CGISQL.cgi"（注册）
+    char flag = url_[1];
+    bool success = false;
+    // 表单原地解码，用户名和密码直接引用请求正文，且都以'\0'结尾
+    FormField fields[4];
+    int count = ParseForm(string_, content_length_, fields, 4);
+    if (count < 0)
+        return BAD_REQUEST;
+    std::string_view name = FindFormValue(fields, count, "user");
+    std::string_view passwd = FindFormValue(fields, count, "password");
+
+#ifdef SYNSQL
+    // 如果为注册
+    if (flag == '3')
+    {
+        std::string inserter = "INSERT INTO user(username, passwd) VALUES('";
+        inserter.append(name).append("', '").append(passwd).append("')");
+        if (users.find(name) == users.end())
         {
-            std::string inserter;
-            inserter = "INSERT INTO user(username, passwd) VALUES('" + name + "', '" + passwd + "')";
-            if (users.find(name) == users.end())
+            int res = 0;
             {
-                {
-                    std::lock_guard<std::mutex> locker(users_locker);
-                    int res = mysql_query(mysql_, inserter.c_str());
-                    users.insert({name, passwd});
-                }
-
-                if (res != 0)
-                {
-                    strcpy(url_, "/log.html");
-                    std::ofstream out("./cgi/id_password.inc", std::ios::app);
-                    out << name << " " << passwd << "\n";
-                }
-                else
-                    strcpy(url_, "/registerError.html");
+                std::lock_guard<std::mutex> locker(users_locker);
+                res = mysql_query(mysql_, inserter.c_str());
+                users.emplace(name, passwd);
             }
-            else
-                strcpy(url_, "/registerError.html");
+            success = res == 0;
         }
+    }
+    else if (flag == '2')
+    {
+        auto user = users.find(name);
+        success = user != users.end() && user->second == passwd;
+    }
+#endif
 
-        else if (*(p + 1) == '2')
+#ifdef CGISQLPOOL
+    if (flag == '3')
+    {
+        std::string inserter = "INSERT INTO user(username, passwd) VALUES('";
+        inserter.append(name).append("', '").append(passwd).append("')");
+        if (users.find(name) == users.end())
         {
-            pid_t pid;
-            int pipe_fd[2];
-            if (pipe(pipe_fd) < 0)
             {
-                LOG_ERROR("pipe error: %d", 4);
-                return BAD_REQUEST;
+                std::lock_guard<std::mutex> locker(users_locker);
+                int res = mysql_query(mysql_, inserter.c_str());
+                users.emplace(name, passwd);
             }
-            if ((pid = fork()) < 0)
-            {
-                LOG_ERROR("fork error: %d", 4);
-                return BAD_REQUEST;
-            }
-            if (pid == 0)
-            {
-                dup2(pipe_fd[1], 1);
-                close(pipe_fd[0]);
-                execl(real_file_, name.c_str(), passwd.c_str(), "./cgi/id_password.inc", (char *)nullptr);
-            }
-            else
+
+            if (res != 0)
             {
-                close(pipe_fd[1]);
-                char result;
-                if (int ret = read(pipe_fd[0], &result, 1) != 1)
-                {
-                    LOG_ERROR("pipe read error: ret=%d", ret);
-                    return BAD_REQUEST;
-                }
-                LOG_INFO("%s", "Sign in checking");
-                Logger::GetInstance()->Flush();
-                if (result == '1')
-                {
-                    strcpy(url_, "/welcome.html");
-                }
-                else
-                    strcpy(url_, "/logError.html");
-                waitpid(pid, nullptr, 0);
+                success = true;
+                std::ofstream out("./cgi/id_password.inc", std::ios::app);
+                out << name << " " << passwd << "\n";
             }
         }
-#endif
+    }
 
-#ifdef CGISQL
+    else if (flag == '2')
+    {
         pid_t pid;
         int pipe_fd[2];
-
-        if (pipe(pipe_fd) == -1)
+        if (pipe(pipe_fd) < 0)
         {
-            LOG_ERROR("pipe() error:%d", 4);
+            LOG_ERROR("pipe error: %d", 4);
             return BAD_REQUEST;
         }
         if ((pid = fork()) < 0)
         {
-            LOG_ERROR("fork() error:%d", 3);
+            LOG_ERROR("fork error: %d", 4);
             return BAD_REQUEST;
         }
-
         if (pid == 0)
         {
             dup2(pipe_fd[1], 1);
             close(pipe_fd[0]);
-            execl(real_file_, &flag, name.c_str(), passwd.c_str(), (char *)nullptr);
+            execl(cgi_program.c_str(), name.data(), passwd.data(), "./cgi/id_password.inc", (char *)nullptr);
         }
         else
         {
             close(pipe_fd[1]);
             char result;
-            int ret = read(pipe_fd[0], &result, 1);
-
-            if (ret != 1)
+            if (int ret = read(pipe_fd[0], &result, 1) != 1)
             {
-                LOG_ERROR("pipe read error: ret =%d", ret);
+                LOG_ERROR("pipe read error: ret=%d", ret);
                 return BAD_REQUEST;
             }
-            if (flag == '2')
-            {
-                LOG_INFO("%s", "Sign in checking");
-                Logger::GetInstance()->Flush();
-                if (result == '1')
-                {
-                    strcpy(url_, "welcon.html");
-                }
-                else
-                {
-                    strcpy(url_, "/logError.html");
-                }
-            }
-            else if (flag == '3')
+            LOG_INFO("%s", "Sign in checking");
+            Logger::GetInstance()->Flush();
+            success = result == '1';
+            waitpid(pid, nullptr, 0);
+        }
+    }
+#endif
+
+#ifdef CGISQL
+    pid_t pid;
+    int pipe_fd[2];
+
+    if (pipe(pipe_fd) == -1)
+    {
+        LOG_ERROR("pipe() error:%d", 4);
+        return BAD_REQUEST;
+    }
+    if ((pid = fork()) < 0)
+    {
+        LOG_ERROR("fork() error:%d", 3);
+        return BAD_REQUEST;
+    }
+
+    if (pid == 0)
+    {
+        dup2(pipe_fd[1], 1);
+        close(pipe_fd[0]);
+        execl(cgi_program.c_str(), &flag, name.data(), passwd.data(), (char *)nullptr);
+    }
+    else
+    {
+        close(pipe_fd[1]);
+        char result;
+        int ret = read(pipe_fd[0], &result, 1);
+
+        if (ret != 1)
+        {
+            LOG_ERROR("pipe read error: ret =%d", ret);
+            return BAD_REQUEST;
+        }
+        if (flag == '2')
+        {
+            LOG_INFO("%s", "Sign in checking");
+            Logger::GetInstance()->Flush();
+            success = result == '1';
+        }
+        else if (flag == '3')
+        {
+            LOG_INFO("%s", "Sign up checking");
+            Logger::GetInstance()->Flush();
+            success = result == '1';
+        }
+        waitpid(pid, NULL, 0);
+    }
+
+#endif
+    return ServeFile(success ? target.path_ : target.failure_);
+}
+
+HttpConnection::HttpCode HttpConnection::ReceiveUpload(const RouteTarget &target, const char *data, size_t length)
+{
+    if (data)
+    {
+        // 分块编码的正文事先不知道长度，边写边累计，超过上限时中止
+        upload_size_ += length;
+        if (upload_size_ > UPLOAD_MAX_SIZE)
+            return BAD_REQUEST;
+        // 正文直接写入文件，不在内存中缓存
+        while (length > 0)
+        {
+            ssize_t written = write(upload_fd_, data, length);
+            if (written < 0)
             {
-                LOG_INFO("%s", "Sign up checking");
-                Logger::GetInstance()->Flush();
-                if (result == '1')
-                    strcpy(url_, "/log.html");
-                else
-                    strcpy(url_, "/registerError.html");
+                if (errno == EINTR)
+                    continue;
+                return INTERNAL_ERROR;
             }
-            waitpid(pid, NULL, 0);
+            data += written;
+            length -= written;
         }
-
+        return NO_REQUEST;
+    }
+    // 正文开始前：检查文件名，创建临时文件
+    const char *name = path_info_;
+    if (!name || !*name || name[0] == '.' || strchr(name, '/') || strlen(name) >= NAME_MAX)
+        return BAD_REQUEST;
+    if (!chunked_ && content_length_ > UPLOAD_MAX_SIZE)
+        return BAD_REQUEST;
+    upload_path_ = target.path_ + "/" + name;
+    // 临时文件以'.'开头，收齐后改名，其他请求看不到写了一半的文件
+    upload_temp_ = target.path_ + "/.upload-" + std::to_string(socket_fd_);
+    upload_fd_ = open(upload_temp_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    upload_size_ = 0;
+    if (upload_fd_ < 0)
+    {
+        upload_temp_.clear();
+        return errno == EACCES ? FORBIDDEN_REQUEST : INTERNAL_ERROR;
+    }
+#ifdef UPLOAD_SPLICE
+    // 分块编码的正文需要解码，只有按Content-Length发送的正文可以直接搬运
+    if (!chunked_)
+        splice_fd_ = upload_fd_;
 #endif
+    return NO_REQUEST;
+}
+
+HttpConnection::HttpCode HttpConnection::DoUpload(const RouteTarget &target)
+{
+    // 没有正文的请求不经过ReceiveUpload，这里创建空文件
+    if (upload_fd_ < 0)
+    {
+        HttpCode ret = ReceiveUpload(target, nullptr, 0);
+        if (ret != NO_REQUEST)
+            return ret;
     }
-    // 根据url判断，将所需文件名拼接到root路径下
-    const char *path;
-    switch (*(p + 1))
+    close(upload_fd_);
+    upload_fd_ = -1;
+    splice_fd_ = -1;
+    if (rename(upload_temp_.c_str(), upload_path_.c_str()) < 0)
+        return INTERNAL_ERROR;
+    upload_temp_.clear();
+    return CREATED_REQUEST;
+}
+
+void HttpConnection::CloseUpload()
+{
+    if (upload_fd_ >= 0)
     {
-    case '0':
-        path = "/register.html";
-        break;
-    case '1':
-        path = "/log.html";
-        break;
-    case '5':
-        path = "/picture.html";
-        break;
-    case '6':
-        path = "/video.html";
-        break;
-    case '7':
-        path = "/webbench.html";
-        break;
-    default:
-        path = url_;
-        break;
+        close(upload_fd_);
+        upload_fd_ = -1;
     }
+    if (!upload_temp_.empty())
+    {
+        unlink(upload_temp_.c_str());
+        upload_temp_.clear();
+    }
+    splice_fd_ = -1;
+    if (pipe_fd_[0] >= 0)
+    {
+        close(pipe_fd_[0]);
+        close(pipe_fd_[1]);
+        pipe_fd_[0] = pipe_fd_[1] = -1;
+    }
+}
 
-    strncpy(real_file_ + len, path, FILNAME_LEN - len - 1);
-    if (stat(real_file_, &file_stat_) < 0)
+HttpConnection::HttpCode HttpConnection::ServeFile(const std::string &real_file)
+{
+    // stat结果和打开的fd都来自文件缓存，文件内容之后由sendfile直接从页缓存发送
+    file_ = FileCache::GetInstance()->Get(real_file);
+    if (!file_)
         return NO_RESOURCE;
     // 判断可否读
-    if (!(file_stat_.st_mode & S_IROTH))
+    if (!(file_->stat_.st_mode & S_IROTH))
     {
         // 不可读返回FORBIDDEN_REQUEST
         return FORBIDDEN_REQUEST;
     }
-    if (S_ISDIR(file_stat_.st_mode))
+    if (S_ISDIR(file_->stat_.st_mode))
     {
         // 若为该文件为目录则返回BAD_REQUEST
         return BAD_REQUEST;
     }
-    // 打开文件，并映射到内存
-    int fd = open(real_file_, O_RDONLY);
-    file_address_ = (char *)mmap(nullptr, file_stat_.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
+    if (file_->fd_ < 0)
+        return INTERNAL_ERROR;
+    const char *range = headers_.Value(HEADER_RANGE);
+#ifdef COMPRESSION
+    // 可压缩的文件按Accept-Encoding换成压缩变体，范围请求按原文件处理
+    if (accept_encodings_ && !range)
+        file_ = FileCache::GetInstance()->GetEncoded(file_, real_file, accept_encodings_);
+#endif
+    // 条件请求针对选定的表示，先于Range判断
+    if (method_ == GET && NotModified())
+        return NOT_MODIFIED;
+    // If-Range与文件不一致时忽略Range，返回整个文件
+    if (range && method_ == GET && (!headers_.Value(HEADER_IF_RANGE) || IfRangeMatches()))
+    {
+        HttpCode ret = ParseRange();
+        if (ret != FILE_REQUEST)
+            return ret;
+    }
     return FILE_REQUEST;
 }
 
-void HttpConnection::Unmap()
+void HttpConnection::CloseFile()
 {
-    if (file_address_)
-    {
-        munmap(file_address_, file_stat_.st_size);
-        file_address_ = nullptr;
-    }
+    file_.reset();
+    segments_.clear();
+    segment_gaps_ = 0;
 }
 
-bool HttpConnection::Write()
+HttpConnection::WriteResult HttpConnection::Write()
 {
-    int tmp = 0, new_add = 0;
+    int tmp = 0;
 
-    if (bytes_to_send_ == 0)
+    if (WriteDone())
     {
-        ModFd(epoll_fd_, socket_fd_, EPOLLIN);
-        Initialize();
-        return true;
+        if (!HasBufferedInput())
+            ModFd(epoll_fd_, socket_fd_, EPOLLIN);
+        return WRITE_DONE;
     }
 
     while (true)
     {
-        tmp = writev(socket_fd_, iv_, iv_count_);
-        if (tmp > 0)
+        int count = 0;
+        struct iovec *iov = GetIovec(&count);
+        if (count > 0)
+        {
+            // 先发送写缓冲区链，后面紧接着文件内容时带上MSG_MORE，
+            // 让内核把响应头和文件开头合并成满的报文段
+            msghdr message;
+            memset(&message, 0, sizeof(message));
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+            tmp = sendmsg(socket_fd_, &message, HasFileToSend() ? MSG_MORE : 0);
+        }
+        else
         {
-            bytes_have_send_ += tmp;
-            new_add = bytes_have_send_ - write_idx_;
+            tmp = SendFile();
         }
-        else if (tmp == -1)
+        if (tmp <= 0)
         {
-            if (errno == EAGAIN)
+            if (tmp == -1 && errno == EAGAIN)
             {
-                if (bytes_have_send_ >= iv_[0].iov_len)
-                {
-                    iv_[0].iov_len = 0;
-                    iv_[1].iov_base = file_address_ + new_add;
-                    iv_[1].iov_len = bytes_to_send_;
-                }
-                else
-                {
-                    iv_[0].iov_base = write_buffer_ + bytes_to_send_;
-                    iv_[0].iov_len = iv_[0].iov_len - bytes_have_send_;
-                }
+                // socket发送缓冲区已满，已发送的部分已经消费，等待下一次可写
                 ModFd(epoll_fd_, socket_fd_, EPOLLOUT);
-                return true;
+                return WRITE_PENDING;
             }
-            Unmap();
-            return false;
+            CloseFile();
+            return WRITE_ERROR;
         }
-        bytes_to_send_ -= tmp;
-        if (bytes_to_send_ <= 0)
+        if (AdvanceWrite(tmp))
         {
-            Unmap();
-            ModFd(epoll_fd_, socket_fd_, EPOLLIN);
-            if (linger_)
-            {
-                Initialize();
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            if (!FinishWrite())
+                return WRITE_ERROR;
+            // 还有已收到的流水线请求时由反应堆直接交给工作线程，此时不能注册读事件
+            if (!HasBufferedInput())
+                ModFd(epoll_fd_, socket_fd_, EPOLLIN);
+            return WRITE_DONE;
         }
     }
 }
 
-// 将相应报文写入缓冲区的工具函数，并输出到日志文件
-bool HttpConnection::AddResponse(const char *format, ...)
+struct iovec *HttpConnection::GetIovec(int *count)
 {
-    if (write_idx_ >= WRITE_BUFFER_SIZE)
-        return false;
-    va_list valist;
-    va_start(valist, format);
-    int len = vsnprintf(write_buffer_ + write_idx_,
-                        WRITE_BUFFER_SIZE - write_idx_ - 1,
-                        format,
-                        valist);
-    if (len >= (WRITE_BUFFER_SIZE - write_idx_ - 1))
-    {
-        va_end(valist);
-        return false;
+    *count = 0;
+    size_t skip = 0, length = 0;
+    // 按顺序填入写缓冲区链中的数据和内存中的正文，遇到要用sendfile发送的文件为止
+    for (const BodySegment &segment : segments_)
+    {
+        if (segment.gap_ > 0)
+        {
+            *count += write_chain_.FillIovec(iv_ + *count, MAX_IOVEC - *count, skip, segment.gap_, &length);
+            skip += length;
+            if (length < segment.gap_)
+                return iv_;
+        }
+        if (segment.file_->fd_ >= 0 || *count == MAX_IOVEC)
+            return iv_;
+        iv_[*count].iov_base = const_cast<char *>(segment.file_->data_.data()) + segment.offset_;
+        iv_[*count].iov_len = segment.end_ - segment.offset_;
+        ++*count;
+    }
+    *count += write_chain_.FillIovec(iv_ + *count, MAX_IOVEC - *count, skip, write_chain_.Size() - skip, &length);
+    return iv_;
+}
+
+bool HttpConnection::HasFileToSend() const
+{
+    return !segments_.empty() && segments_.front().file_->fd_ >= 0;
+}
+
+ssize_t HttpConnection::SendFile()
+{
+    // GetIovec没有返回数据时，下一部分一定是要用sendfile发送的文件。偏移由AdvanceWrite统一推进，这里传入副本
+    const BodySegment &segment = segments_.front();
+    off_t offset = segment.offset_;
+    return sendfile(socket_fd_, segment.file_->fd_, &offset, segment.end_ - segment.offset_);
+}
+
+bool HttpConnection::AdvanceWrite(size_t sent)
+{
+    bytes_have_send_ += sent;
+    // 按发送顺序依次消费写缓冲区链和各正文部分
+    while (sent > 0 && !segments_.empty())
+    {
+        BodySegment &segment = segments_.front();
+        if (segment.gap_ > 0)
+        {
+            size_t count = sent < segment.gap_ ? sent : segment.gap_;
+            write_chain_.Consume(count);
+            segment.gap_ -= count;
+            segment_gaps_ -= count;
+            sent -= count;
+            continue;
+        }
+        off_t count = segment.end_ - segment.offset_;
+        if ((off_t)sent < count)
+            count = sent;
+        segment.offset_ += count;
+        sent -= count;
+        if (segment.offset_ == segment.end_)
+            segments_.pop_front();
+    }
+    write_chain_.Consume(sent);
+    return WriteDone();
+}
+
+bool HttpConnection::FinishWrite()
+{
+    CloseFile();
+    return !close_after_write_;
+}
+
+bool HttpConnection::AddChunk(const char *data, size_t length)
+{
+    // 长度为0的块表示正文结束，不能用来发送空数据
+    if (length == 0)
+        return true;
+    char buffer[16];
+    char *begin = FormatHex(buffer + sizeof(buffer) - 2, length);
+    memcpy(buffer + sizeof(buffer) - 2, "\r\n", 2);
+    AddResponse(begin, buffer + sizeof(buffer) - begin);
+    write_chain_.Append(data, length);
+    return AddBlankLine();
+}
+
+bool HttpConnection::AppendInput(const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t space;
+        char *buffer = ReadSpace(&space, MAX_BUFFERED_INPUT);
+        if (!buffer)
+            return false;
+        size_t count = length < space ? length : space;
+        memcpy(buffer, data, count);
+        read_chain_.Commit(count);
+        data += count;
+        length -= count;
     }
-    write_idx_ += len;
-    va_end(valist);
-    LOG_INFO("request:%s", write_buffer_);
-    Logger::GetInstance()->Flush();
     return true;
 }
 
+HttpConnection::ProcessResult HttpConnection::ProcessRequest()
+{
+    // 依次处理已收到的所有完整请求，响应按顺序排在写缓冲区链中，之后一起发送
+    int responses = 0;
+    while (responses < MAX_PIPELINE && !close_after_write_)
+    {
+        HttpCode code = ProcessRead();
+        if (code == NO_REQUEST)
+            break;
+        // 请求格式错误时无法确定请求的边界，响应后关闭连接
+        if (!request_complete_)
+            linger_ = false;
+        if (!ProcessWrite(code))
+        {
+            // 先发送前面请求的响应，然后关闭连接
+            close_after_write_ = true;
+            break;
+        }
+        ++responses;
+        if (!linger_)
+            close_after_write_ = true;
+        // 丢弃已处理的请求，保留流水线中后续请求的数据
+        read_chain_.Consume(request_length_);
+        if (read_chain_.Empty())
+            read_chain_.Clear();
+        ResetRequest();
+    }
+    if (responses > 0)
+        return PROCESS_RESPONSE;
+    // 没有可响应的请求，且出错或缓存的数据已达上限仍不是完整的请求
+    if (close_after_write_ || read_chain_.Size() >= (size_t)MAX_REQUEST_SIZE)
+        return PROCESS_ERROR;
+    return PROCESS_INCOMPLETE;
+}
+
 void HttpConnection::Process()
 {
-    HttpCode code = ProcessRead();
-    if (code == NO_REQUEST)
+    ProcessResult result = ProcessRequest();
+    if (result == PROCESS_INCOMPLETE)
     {
         ModFd(epoll_fd_, socket_fd_, EPOLLIN);
         return;
     }
-    if (!ProcessWrite(code))
+    if (result == PROCESS_ERROR)
     {
         CloseConnection();
     }
@@ -15,13 +15,25 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/mman.h>
 #include <stdarg.h>
 #include <errno.h>
 #include <sys/wait.h>
 #include <sys/uio.h>
+#include <sys/sendfile.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
 
 #include "cgi/mysql_connect_pool.h"
+#include "pool/buffer_chain.h"
+#include "http/file_cache.h"
+#include "http/header_table.h"
+#include "http/response_builder.h"
+#include "http/router.h"
+#include "http/url_decoder.h"
+#include "time/coarse_clock.h"
 
 // 设置非阻塞
 int SetNonBlock(int fd);
@@ -34,11 +46,26 @@ class HttpConnection
 {
 public:
     static const int FILNAME_LEN = 200,
-                     READ_BUFFER_SIZE = 2048,
-                     WRITE_BUFFER_SIZE = 1024;
-    static int epoll_fd_;
-    static int user_count_;
+                     // 一个请求（请求行、请求头和正文）的最大长度
+                     MAX_REQUEST_SIZE = 64 * 1024,
+                     // io_uring后端的多次接收无法反压，最多缓存的流水线请求数据长度
+                     MAX_BUFFERED_INPUT = 16 * MAX_REQUEST_SIZE,
+                     // 一次writev最多使用的iovec个数
+                     MAX_IOVEC = 32,
+                     // 一次最多处理的流水线请求数，其余请求在这些响应发送完后处理
+                     MAX_PIPELINE = 32,
+                     // 一个Range请求最多包含的范围数，超过时忽略Range返回整个文件
+                     MAX_RANGES = 16,
+                     // 一次splice搬运的最大长度，与管道的默认容量相同
+                     SPLICE_SIZE = 64 * 1024,
+                     // 块大小最多的十六进制位数，再长会使块大小溢出
+                     MAX_CHUNK_SIZE_DIGITS = 15;
+    // 所有反应堆的连接总数
+    static std::atomic<int> user_count_;
     MYSQL *mysql_;
+    // 已交给线程池而尚未处理完的次数，由反应堆在Append前加一、工作线程处理完后减一。
+    // 不为0时反应堆不能回收连接对象
+    std::atomic<int> in_flight_;
     // 请求的方法
     enum Method
     {
@@ -68,9 +95,22 @@ public:
         NO_RESOURCE,       // 资源不存在
         FORBIDDEN_REQUEST, // 请求资源禁止访问，没有读取权限
         FILE_REQUEST,      // 请求资源可以访问，调用Process_write()完成响应
+        PARTIAL_REQUEST,   // 请求资源的一个或多个范围，返回206
+        RANGE_NOT_SATISFIABLE, // 请求的范围都超出了文件长度，返回416
+        NOT_MODIFIED,      // 客户端缓存的文件仍然有效，返回304
+        CREATED_REQUEST,   // 上传的文件已保存，返回201
+        DYNAMIC_REQUEST,   // 处理函数已把完整的响应（分块编码的正文）写入写缓冲区链
         INTERNAL_ERROR,    // 服务器内部出错
         CLOSED_CONNECTION  // 链接关闭（未使用）
     };
+    // 分块编码的请求正文的解析状态
+    enum ChunkState
+    {
+        CHUNK_SIZE,     // 块大小行
+        CHUNK_DATA,     // 块数据
+        CHUNK_DATA_END, // 块数据后的"\r\n"
+        CHUNK_TRAILER   // 最后一块之后的尾部字段
+    };
     // 从状态机状态
     enum LineStatus
     {
@@ -78,111 +118,296 @@ public:
         LINE_BAD,
         LINE_OPEN
     };
+    // 一次解析的结果
+    enum ProcessResult
+    {
+        PROCESS_INCOMPLETE, // 请求不完整，需要继续读取
+        PROCESS_RESPONSE,   // 响应已准备好，等待发送
+        PROCESS_ERROR       // 生成响应失败，应关闭连接
+    };
+    // 一次发送的结果
+    enum WriteResult
+    {
+        WRITE_DONE,    // 排队的响应已全部发送
+        WRITE_PENDING, // socket发送缓冲区已满，已注册可写事件，等待继续发送
+        WRITE_ERROR    // 发送出错或响应后应关闭连接
+    };
 
-    HttpConnection(){};
-    ~HttpConnection(){};
+    HttpConnection() : in_flight_(0), socket_fd_(-1), read_block_(nullptr), upload_fd_(-1), splice_fd_(-1), pipe_fd_{-1, -1} {};
+    // 关闭正在发送的文件，缓冲区链析构时归还各自的块
+    ~HttpConnection();
 
 public:
-    // 初始化socket地址
-    void Initialize(int socket_fd, const sockaddr_in &addr);
-    // 断开Http连接
+    // 初始化socket地址，并注册到所属反应堆的epoll实例
+    void Initialize(int socket_fd, const sockaddr_in &addr, int epoll_fd);
+    // 关闭socket的读写，连接由所属反应堆在收到挂起事件后回收
     void CloseConnection(bool real_close = true);
     // 调用其他成员函数，执行读取请求和生成响应的任务，最后关闭连接
     void Process();
     // 循环读取socket中的数据，直到无数据可读或者对端关闭连接
     bool ReadOnce();
-    // 写入响应报文
-    bool Write();
+    // 写入响应报文。只有返回WRITE_DONE时连接才回到反应堆手中，可以处理流水线中的后续请求
+    WriteResult Write();
+    // 解析读缓冲区中已收到的完整请求并按顺序准备响应，由Process和io_uring后端调用
+    ProcessResult ProcessRequest();
+    // 读缓冲区中是否还有未处理的数据，即流水线中后续的请求
+    bool HasBufferedInput() const { return !read_chain_.Empty(); }
+    // 把已收到的数据追加到读缓冲区，缓存的数据超过MAX_BUFFERED_INPUT时返回false
+    bool AppendInput(const char *data, size_t length);
+    // 按发送顺序取得写缓冲区链和内存中正文尚未发送的部分，直到下一个要用sendfile发送的文件，
+    // 返回的数组在下一次调用前有效。返回0个时应调用SendFile
+    struct iovec *GetIovec(int *count);
+    // 接下来是否要用sendfile发送文件内容
+    bool HasFileToSend() const;
+    // 用sendfile发送下一个文件部分，返回值同sendfile
+    ssize_t SendFile();
+    // 记录已发送sent字节，返回排队的响应是否已全部发送
+    bool AdvanceWrite(size_t sent);
+    // 响应全部发送完毕后调用，返回false表示应关闭连接
+    bool FinishWrite();
     // 返回地址信息
     const sockaddr_in *GetAddress() { return &address_; };
     // 同步线程初始化数据库读取表
     static void InitMysqlResult(ConnectPool *conn_pool);
     // CGI线程池初始化数据库
     static void InitResultFile(ConnectPool *conn_pool);
+    // 启用文档根目录的文件缓存，启用上传时同时建好上传目录
+    static void InitFileCache(size_t max_files);
 
 private:
     void Initialize();
+    // 一个请求处理完后重置解析状态，下一个请求从读缓冲区链头部开始
+    void ResetRequest();
     // 从读缓冲区读取并处理请求
     HttpCode ProcessRead();
     // 向写缓冲区写入响应
     bool ProcessWrite(HttpCode ret);
-    // 解析请求行
-    HttpCode ParseRequestLine(char *text);
-    // 解析请求头
-    HttpCode ParseHeaders(char *text);
+    // 解析请求行，length为不含行结束符的长度
+    HttpCode ParseRequestLine(char *text, size_t length);
+    // 解析请求头，length为不含行结束符的长度
+    HttpCode ParseHeaders(char *text, size_t length);
     // 解析请求正文，仅POST请求会调用
     HttpCode ParseContent(char *text);
-    // 生成响应
+    // 解码分块编码的请求正文，可在数据陆续到达时多次调用，解码结果放在body_中或交给正文处理函数
+    HttpCode ParseChunked();
+    // 把已收到的正文交给路由的正文处理函数，收齐Content-Length后返回GET_REQUEST
+    HttpCode StreamContent();
+    // 释放读缓冲区链中已解析的部分，流式正文由此限制每个连接缓存的数据量
+    void ReleaseParsed();
+    // 正文不经读缓冲区链，用splice从socket经管道直接写入splice_fd_
+    bool SpliceBody();
+    // 按路由表分派请求，生成响应
     HttpCode DoRequest();
+    // 路由的处理函数，新的接口在Routes()中注册即可。
+    // 正文处理函数在正文开始前以data为nullptr调用一次，此时url_和请求头仍可用，之后每收到一段正文调用一次，
+    // 返回NO_REQUEST表示继续，其他值表示中止并以该结果响应
+    typedef HttpCode (HttpConnection::*RouteHandler)(const RouteTarget &target);
+    typedef HttpCode (HttpConnection::*BodyHandler)(const RouteTarget &target, const char *data, size_t length);
+    typedef Router<RouteHandler, BodyHandler> RouteTable;
+    static const RouteTable &Routes();
+    // 返回路由指定的页面
+    HttpCode DoStatic(const RouteTarget &target);
+    // 登录和注册，成功时返回target.path_，否则返回target.failure_
+    HttpCode DoSign(const RouteTarget &target);
+    // 以文档根目录下的real_file响应
+    HttpCode ServeFile(const std::string &real_file);
+    // 上传：正文写入upload目录下的临时文件，收齐后改名为path_info_指定的文件名
+    HttpCode ReceiveUpload(const RouteTarget &target, const char *data, size_t length);
+    HttpCode DoUpload(const RouteTarget &target);
+    // 关闭上传的文件，未完成的上传删除其临时文件
+    void CloseUpload();
+    // 服务器状态页：连接数、文件缓存和用户表的统计，边生成边以分块编码输出
+    HttpCode DoStatus(const RouteTarget &target);
+    // 状态页中的一行，作为一个块写入
+    void AddStatusRow(const char *name, unsigned long long value);
+    // 解析Range请求头，语法错误或不支持时返回FILE_REQUEST，按整个文件响应
+    HttpCode ParseRange();
+    // If-Range中的验证器是否与文件一致
+    bool IfRangeMatches() const;
+    // 按If-None-Match或If-Modified-Since判断客户端缓存的文件是否仍然有效
+    bool NotModified() const;
+    // 生成多范围响应中一个范围的分隔头写入buffer，返回其长度。buffer至少要有256字节
+    int RangePartHeader(int index, unsigned long long boundary, char *buffer) const;
+    // 把file_中[offset, end)的内容排在写缓冲区链当前的末尾之后发送
+    void PushBody(off_t offset, off_t end);
+    bool WriteDone() const { return write_chain_.Empty() && segments_.empty(); }
     // 用于偏移指针，指向未处理的行的第一个字符
     char *GetLine() { return read_buffer_ + start_line_; };
     // 从状态机解析一行，返回改行是请求的那个部分
     LineStatus PraseLine();
+    // 返回读缓冲区链尾部可写入的区域，尾块已满时追加新块，缓存的数据达到limit时返回nullptr
+    char *ReadSpace(size_t *length, size_t limit);
+    // 尾块写满时，返回其中应保留的数据长度，之后未完整的一行移入新块
+    size_t LineBoundary(BufferBlock *block);
+    // 当前块已解析完，转到下一个块
+    void NextReadBlock();
 
-    void Unmap();
-    // 生成响应的8个部分
-    bool AddResponse(const char *format, ...);
+    void CloseFile();
+    // 生成响应的各个部分。状态行和字段名都是预先写好的字符串，数字用FormatDecimal转换，
+    // 直接复制进写缓冲区链，不经过格式化
+    bool AddResponse(const char *data, size_t length)
+    {
+        write_chain_.Append(data, length);
+        return true;
+    }
+    template <size_t N>
+    bool AddResponse(const char (&text)[N])
+    {
+        return AddResponse(text, N - 1);
+    }
+    bool AddResponse(const std::string &text)
+    {
+        return AddResponse(text.data(), text.size());
+    }
+    bool AddNumber(unsigned long long value)
+    {
+        char buffer[MAX_DECIMAL_DIGITS];
+        char *begin = FormatDecimal(buffer + sizeof(buffer), value);
+        return AddResponse(begin, buffer + sizeof(buffer) - begin);
+    }
     bool AddContent(const char *content)
     {
-        return AddResponse("%s", content);
+        return AddResponse(content, strlen(content));
     }
-    bool AddStatusLine(int status, const char *title)
+    // line为完整的状态行，之后紧跟Date
+    template <size_t N>
+    bool AddStatusLine(const char (&line)[N])
     {
-        return AddResponse("%s %d %s\r\n", "HTTP/1.1", status, title);
-    };
+        AddResponse(line);
+        return AddDate();
+    }
+    bool AddDate()
+    {
+        std::string_view date = CoarseClock::HttpDate();
+        return AddResponse(date.data(), date.size());
+    }
     bool AddHeader(int content_length)
     {
         AddContentLength(content_length);
         AddLinger();
         AddContentType();
-        AddBlankLine();
+        return AddBlankLine();
     }
     bool AddContentType()
     {
-        return AddResponse("Content-Type:%s\r\n", "text/html");
+        return AddResponse("Content-Type:text/html\r\n");
     }
-    bool AddContentLength(int content_length)
+    bool AddContentLength(unsigned long long content_length)
     {
-        return AddResponse("Content-Length: %d\r\n", content_length);
+        AddResponse("Content-Length: ");
+        AddNumber(content_length);
+        return AddResponse("\r\n");
     }
     bool AddLinger()
     {
-        return AddResponse("Connection: %s\r\n", linger_ ? "keep-alive" : "close");
+        return linger_ ? AddResponse("Connection: keep-alive\r\n") : AddResponse("Connection: close\r\n");
     }
     bool AddBlankLine()
     {
-        return AddResponse("%s", "\r\n");
+        return AddResponse("\r\n");
+    }
+    // 长度事先未知的响应正文：用AddChunkedHeader代替AddHeader，
+    // 之后每产生一段数据调用一次AddChunk，最后调用AddLastChunk
+    bool AddChunkedHeader()
+    {
+        AddResponse("Transfer-Encoding: chunked\r\n");
+        AddLinger();
+        AddContentType();
+        return AddBlankLine();
+    }
+    bool AddChunk(const char *data, size_t length);
+    bool AddLastChunk()
+    {
+        return AddResponse("0\r\n\r\n");
     }
 
 private:
     int socket_fd_;
-    // 读缓冲区中数据最后一字节的下一个位置
-    int read_idx_, write_idx_, checked_idx_;
-    // 读缓冲区中一个数据行的起始位置
+    // 连接所属反应堆的epoll实例
+    int epoll_fd_;
+    // 读缓冲区链和正在解析的块
+    BufferChain read_chain_;
+    BufferBlock *read_block_;
+    // 正在解析的块的数据区
+    char *read_buffer_;
+    // 块中数据最后一字节的下一个位置和已检查到的位置
+    int read_idx_, checked_idx_;
+    // 块中一个数据行的起始位置
     int start_line_;
+    // 正在解析的请求在read_block_之前的块中的字节数
+    size_t passed_;
+    // 已解析完的请求的总长度，响应后从读缓冲区链中消费
+    size_t request_length_;
+    // 请求的边界已确定，为false时无法找到下一个请求，响应后关闭连接
+    bool request_complete_;
+    // 跨越多个块的正文拼接在这里
+    std::string body_;
+    // 排队的各响应的响应头和内存中的响应正文
+    BufferChain write_chain_;
+    // 穿插在写缓冲区链中的文件正文部分
+    struct BodySegment
+    {
+        std::shared_ptr<const CachedFile> file_;
+        // 尚未发送的范围
+        off_t offset_, end_;
+        // 写缓冲区链中排在该部分之前、上一部分之后的字节数
+        size_t gap_;
+    };
+    std::deque<BodySegment> segments_;
+    // 各正文部分gap_之和，写缓冲区链中超出的部分排在最后一个正文部分之后
+    size_t segment_gaps_;
+    // 排队的响应发送完后关闭连接
+    bool close_after_write_;
     // 正文长度
-    int content_length_;
+    long long content_length_;
+    // 请求正文是否使用分块编码，以及解码的状态
+    bool chunked_;
+    ChunkState chunk_state_;
+    // 正在解析的块的剩余长度
+    size_t chunk_size_;
+    // 块大小行中的十六进制位数，或者尾部字段中当前行的长度
+    int chunk_line_;
+    // 块大小行中是否已进入扩展部分
+    bool chunk_extension_;
     // 是否持续连接
     bool linger_;
-    // 请求的html文件名和读、写缓冲区
-    char real_file_[FILNAME_LEN],
-        read_buffer_[READ_BUFFER_SIZE],
-        write_buffer_[WRITE_BUFFER_SIZE];
 
+    // 解码并规范化后的路径，以及未解码的查询串，没有查询串时为nullptr
     char *url_;
+    char *query_;
     char *http_version_;
-    char *host_;
-    // 读取服务器上的文件地址
-    char *file_address_;
+    // 请求头收齐时确定的路由，以及前缀路由之后剩余的路径
+    const RouteTable::Route *route_;
+    const char *path_info_;
+    // 正文是否交给路由的正文处理函数逐段处理，以及按Content-Length尚未收到的长度
+    bool streaming_;
+    long long body_remaining_;
+    // 正在写入的上传临时文件、已写入的长度、其路径和最终路径
+    int upload_fd_;
+    long long upload_size_;
+    std::string upload_temp_;
+    std::string upload_path_;
+    // 不为-1时正文用splice写入该fd，以及中转用的管道
+    int splice_fd_;
+    int pipe_fd_[2];
+    // 请求头表，值指向读缓冲区
+    HeaderTable headers_;
+    // 当前请求的文件，来自文件缓存，可能是压缩变体
+    std::shared_ptr<const CachedFile> file_;
+    // 客户端接受的内容编码，以1 << ContentEncoding为位
+    unsigned accept_encodings_;
 
-    struct stat file_stat_;
-    struct iovec iv_[2];
-    int iv_count_;
+    // 请求的范围，闭区间
+    struct ByteRange
+    {
+        off_t first_, last_;
+    } ranges_[MAX_RANGES];
+    int range_count_;
+    struct iovec iv_[MAX_IOVEC];
     // 是否启用POST
     int cgi_;
     // 请求正文信息
     char *string_;
-    int bytes_to_send_;
     int bytes_have_send_;
     // 从状态机的状态，表示在读缓冲区中读取的位置
     CheckState check_state_;
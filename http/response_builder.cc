@@ -0,0 +1,55 @@
+#include <cstring>
+
+#include "response_builder.h"
+
+namespace
+{
+// 00到99的两位数字，每次除以100处理两位
+const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+} // namespace
+
+char *FormatDecimal(char *end, unsigned long long value, int width)
+{
+    char *p = end;
+    while (value >= 100)
+    {
+        const char *pair = DIGIT_PAIRS + (value % 100) * 2;
+        value /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (value >= 10)
+    {
+        const char *pair = DIGIT_PAIRS + value * 2;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    else
+    {
+        *--p = '0' + value;
+    }
+    while (end - p < width)
+        *--p = '0';
+    return p;
+}
+
+char *FormatHex(char *end, unsigned long long value)
+{
+    char *p = end;
+    do
+    {
+        *--p = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    } while (value);
+    return p;
+}
@@ -0,0 +1,17 @@
+#ifndef HTTP_RESPONSE_BUILDER_H
+#define HTTP_RESPONSE_BUILDER_H
+
+#include <cstddef>
+
+// 生成响应头用到的格式化函数，代替snprintf
+
+// 十进制整数最长的字符数
+const int MAX_DECIMAL_DIGITS = 20;
+
+// 把value的十进制表示写在end之前，不足width位时前补'0'，返回第一个字符的位置。
+// end之前至少要有max(width, MAX_DECIMAL_DIGITS)个字节
+char *FormatDecimal(char *end, unsigned long long value, int width = 1);
+// 同上，写十六进制小写表示
+char *FormatHex(char *end, unsigned long long value);
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef HTTP_ROUTER_H
+#define HTTP_ROUTER_H
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 路由预先确定的目标文件，交给处理函数
+struct RouteTarget
+{
+    RouteTarget(std::string path, std::string failure = std::string())
+        : path_(std::move(path)), failure_(std::move(failure)) {}
+
+    // 拼好文档根目录的文件路径
+    std::string path_;
+    // 处理失败时返回的文件路径，没有时为空
+    std::string failure_;
+};
+
+// 以路径为键的基数树，把请求方法和路径映射到处理函数。
+// 启动时建立，之后只读，查找时逐段比较路径，不分配内存。
+// Handler在请求收齐后生成响应；BodyHandler不为空时请求正文不再整体缓存，而是边收边交给它
+template <class Handler, class BodyHandler>
+class Router
+{
+public:
+    struct Route
+    {
+        // 允许的请求方法，以1 << Method为位
+        unsigned methods_;
+        // 是否按前缀匹配，路径的剩余部分交给处理函数
+        bool prefix_;
+        Handler handler_;
+        BodyHandler body_handler_;
+        RouteTarget target_;
+    };
+
+    Router() : nodes_(1){};
+
+    // 注册与path完全匹配的路由。同一路径可以为不同的方法注册不同的处理函数，先注册的优先
+    void Add(unsigned methods, const std::string &path, Handler handler, const RouteTarget &target,
+             BodyHandler body_handler = nullptr)
+    {
+        Insert(Route{methods, false, handler, body_handler, target}, path);
+    }
+    // 注册以prefix开头的路径的路由，完全匹配的路由和更长的前缀优先
+    void AddPrefix(unsigned methods, const std::string &prefix, Handler handler, const RouteTarget &target,
+                   BodyHandler body_handler = nullptr)
+    {
+        Insert(Route{methods, true, handler, body_handler, target}, prefix);
+    }
+
+    // 返回与method和[path, path + length)匹配的路由，没有时返回nullptr。
+    // rest不为空时返回路径中路由之后的剩余部分
+    const Route *Find(int method, const char *path, size_t length, const char **rest = nullptr) const
+    {
+        const Route *matched = nullptr;
+        const char *matched_rest = nullptr;
+        int node = 0;
+        while (true)
+        {
+            // 路径在该节点结束时完全匹配的路由优先，否则取该节点上的前缀路由
+            const Route *found = nullptr;
+            for (int index : nodes_[node].routes_)
+            {
+                const Route &route = routes_[index];
+                if (!(route.methods_ & (1u << method)))
+                    continue;
+                if (length == 0 && !route.prefix_)
+                {
+                    found = &route;
+                    break;
+                }
+                if (route.prefix_ && !found)
+                    found = &route;
+            }
+            if (found)
+            {
+                matched = found;
+                matched_rest = path;
+            }
+            if (length == 0)
+                break;
+            node = FindChild(node, *path);
+            if (node < 0)
+                break;
+            const std::string &edge = nodes_[node].prefix_;
+            if (edge.size() > length || memcmp(edge.data(), path, edge.size()) != 0)
+                break;
+            path += edge.size();
+            length -= edge.size();
+        }
+        if (rest)
+            *rest = matched_rest;
+        return matched;
+    }
+
+private:
+    struct Node
+    {
+        // 从父节点到该节点的边上的路径片段
+        std::string prefix_;
+        std::vector<int> children_;
+        // 终止于该节点的路由在routes_中的下标
+        std::vector<int> routes_;
+    };
+
+    void Insert(const Route &route, const std::string &path)
+    {
+        int node = 0;
+        size_t matched = 0;
+        while (matched < path.size())
+        {
+            int child = FindChild(node, path[matched]);
+            if (child < 0)
+            {
+                // 剩余的路径作为一条新边
+                child = nodes_.size();
+                nodes_.emplace_back();
+                nodes_[child].prefix_ = path.substr(matched);
+                nodes_[node].children_.push_back(child);
+                node = child;
+                break;
+            }
+            const std::string &prefix = nodes_[child].prefix_;
+            size_t common = 0;
+            while (common < prefix.size() && matched + common < path.size() && prefix[common] == path[matched + common])
+                ++common;
+            if (common < prefix.size())
+            {
+                // 只匹配了边的一部分，从分叉处把边拆成两段
+                int middle = nodes_.size();
+                nodes_.emplace_back();
+                nodes_[middle].prefix_ = nodes_[child].prefix_.substr(0, common);
+                nodes_[middle].children_.push_back(child);
+                nodes_[child].prefix_.erase(0, common);
+                for (int &index : nodes_[node].children_)
+                {
+                    if (index == child)
+                        index = middle;
+                }
+                child = middle;
+            }
+            node = child;
+            matched += common;
+        }
+        nodes_[node].routes_.push_back(routes_.size());
+        routes_.push_back(route);
+    }
+
+    // 子节点的边以不同的字符开头，最多一个匹配
+    int FindChild(int node, char first) const
+    {
+        for (int child : nodes_[node].children_)
+        {
+            if (nodes_[child].prefix_[0] == first)
+                return child;
+        }
+        return -1;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<Route> routes_;
+};
+
+#endif
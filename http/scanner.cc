@@ -0,0 +1,105 @@
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "scanner.h"
+
+namespace
+{
+typedef const char *(*FindFunction)(const char *, const char *, char, char);
+
+const char *FindScalar(const char *p, const char *end, char a, char b)
+{
+    for (; p < end; ++p)
+    {
+        if (*p == a || *p == b)
+            return p;
+    }
+    return end;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse4.2"))) const char *FindSse42(const char *p, const char *end, char a, char b)
+{
+    // PCMPESTRI在16个字节中查找字符集合中任意字符第一次出现的位置
+    const __m128i set = _mm_setr_epi8(a, b, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int index = _mm_cmpestri(set, 2, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (index < 16)
+            return p + index;
+    }
+    // 不足16字节的尾部逐字节比较，避免读越界
+    return FindScalar(p, end, a, b);
+}
+
+__attribute__((target("avx2"))) const char *FindAvx2(const char *p, const char *end, char a, char b)
+{
+    const __m256i first = _mm256_set1_epi8(a);
+    const __m256i second = _mm256_set1_epi8(b);
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i matched = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, first), _mm256_cmpeq_epi8(chunk, second));
+        unsigned mask = _mm256_movemask_epi8(matched);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return FindSse42(p, end, a, b);
+}
+
+#endif
+
+struct Implementation
+{
+    FindFunction find_;
+    const char *name_;
+};
+
+Implementation Select()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {FindAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse4.2"))
+        return {FindSse42, "sse4.2"};
+#endif
+    return {FindScalar, "scalar"};
+}
+
+const Implementation implementation = Select();
+} // namespace
+
+const char *FindFirstOf(const char *begin, const char *end, char a, char b)
+{
+    return implementation.find_(begin, end, a, b);
+}
+
+const char *ScannerName()
+{
+    return implementation.name_;
+}
+
+bool SplitHeaderField(char *line, size_t length, HeaderField *field)
+{
+    char *end = line + length;
+    char *colon = static_cast<char *>(memchr(line, ':', length));
+    if (!colon || colon == line)
+        return false;
+    field->name_ = line;
+    field->name_length_ = colon - line;
+    char *value = colon + 1;
+    while (value < end && (*value == ' ' || *value == '\t'))
+        ++value;
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    *end = '\0';
+    field->value_ = value;
+    field->value_length_ = end - value;
+    return true;
+}
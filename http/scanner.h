@@ -0,0 +1,41 @@
+#ifndef HTTP_SCANNER_H
+#define HTTP_SCANNER_H
+
+#include <cstddef>
+
+// 请求报文的扫描函数。查找分隔符时每次比较16或32个字节，
+// 启动时按CPU支持的指令集选择AVX2、SSE4.2或逐字节的实现
+
+// 返回[begin, end)中第一个等于a或b的字符的位置，没有时返回end
+const char *FindFirstOf(const char *begin, const char *end, char a, char b);
+// 当前使用的实现，用于日志
+const char *ScannerName();
+
+// 行结束符'\r'或'\n'
+inline const char *FindLineEnd(const char *begin, const char *end)
+{
+    return FindFirstOf(begin, end, '\r', '\n');
+}
+inline char *FindLineEnd(char *begin, char *end)
+{
+    return const_cast<char *>(FindFirstOf(begin, end, '\r', '\n'));
+}
+// 请求行中的分隔符' '或'\t'
+inline char *FindBlank(char *begin, char *end)
+{
+    return const_cast<char *>(FindFirstOf(begin, end, ' ', '\t'));
+}
+
+// 一个请求头字段，值已去掉首尾的空白并以'\0'结尾
+struct HeaderField
+{
+    const char *name_;
+    size_t name_length_;
+    char *value_;
+    size_t value_length_;
+};
+
+// 一次扫描把长度为length的请求头行拆分为字段名和值，没有':'或字段名为空时返回false
+bool SplitHeaderField(char *line, size_t length, HeaderField *field);
+
+#endif
@@ -0,0 +1,164 @@
+#include <cstring>
+
+#include "url_decoder.h"
+#include "scanner.h"
+
+namespace
+{
+// 十六进制数字的值，不是十六进制数字时返回-1
+int HexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+// 解码p处的"%xx"，格式错误或为"%00"时返回-1
+int DecodeEscape(const char *p, const char *end)
+{
+    if (end - p < 3)
+        return -1;
+    int high = HexValue(p[1]);
+    int low = HexValue(p[2]);
+    if (high < 0 || low < 0 || (high | low) == 0)
+        return -1;
+    return high << 4 | low;
+}
+
+// 路径段[segment, w)写完后处理"."和".."，返回新的写入位置，".."越过根目录时返回nullptr。
+// segment的前一个字符总是'/'
+char *CloseSegment(char *begin, char *segment, char *w)
+{
+    size_t length = w - segment;
+    if (length == 1 && segment[0] == '.')
+        return segment;
+    if (length == 2 && segment[0] == '.' && segment[1] == '.')
+    {
+        // 回到上一段的开头
+        char *slash = segment - 1;
+        if (slash == begin)
+            return nullptr;
+        while (slash[-1] != '/')
+            --slash;
+        return slash;
+    }
+    return w;
+}
+} // namespace
+
+char *DecodeComponent(char *begin, char *end, bool plus_as_space)
+{
+    char special = plus_as_space ? '+' : '%';
+    // 第一个转义之前的部分原样保留
+    char *r = const_cast<char *>(FindFirstOf(begin, end, '%', special));
+    char *w = r;
+    while (r < end)
+    {
+        if (*r == '+')
+        {
+            *w++ = ' ';
+            ++r;
+        }
+        else
+        {
+            int c = DecodeEscape(r, end);
+            if (c < 0)
+                return nullptr;
+            *w++ = c;
+            r += 3;
+        }
+        // 两个转义之间的普通字符
+        char *next = const_cast<char *>(FindFirstOf(r, end, '%', special));
+        memmove(w, r, next - r);
+        w += next - r;
+        r = next;
+    }
+    return w;
+}
+
+char *CanonicalizePath(char *begin, char *end)
+{
+    // 常见的情况：没有转义，'.'都不在段首（如扩展名），路径已是规范形式
+    char *r = begin;
+    while ((r = const_cast<char *>(FindFirstOf(r, end, '%', '.'))) < end && *r == '.' && r[-1] != '/')
+        ++r;
+    if (r == end)
+        return end;
+    // 从第一个需要处理的字符所在的段开始，之前的部分不变
+    while (r[-1] != '/')
+        --r;
+    char *segment = r;
+    char *w = r;
+    while (r < end)
+    {
+        int c = *r;
+        if (c == '%')
+        {
+            c = DecodeEscape(r, end);
+            if (c < 0)
+                return nullptr;
+            r += 3;
+        }
+        else
+        {
+            ++r;
+        }
+        if (c == '/')
+        {
+            char *closed = CloseSegment(begin, segment, w);
+            if (!closed)
+                return nullptr;
+            // "."和".."段去掉后前面已有'/'
+            if (closed != w)
+            {
+                w = segment = closed;
+                continue;
+            }
+            *w++ = '/';
+            segment = w;
+            continue;
+        }
+        *w++ = c;
+    }
+    return CloseSegment(begin, segment, w);
+}
+
+int ParseForm(char *data, size_t length, FormField *fields, int max_count)
+{
+    char *end = data + length;
+    int count = 0;
+    for (char *p = data; p < end && count < max_count;)
+    {
+        char *field_end = static_cast<char *>(memchr(p, '&', end - p));
+        if (!field_end)
+            field_end = end;
+        char *equal = static_cast<char *>(memchr(p, '=', field_end - p));
+        char *name_end = equal ? equal : field_end;
+        char *value = equal ? equal + 1 : field_end;
+        char *decoded_name = DecodeComponent(p, name_end, true);
+        char *decoded_value = DecodeComponent(value, field_end, true);
+        if (!decoded_name || !decoded_value)
+            return -1;
+        // 解码结果不长于原文，结尾处的'&'、'='或原有的'\0'之前总有位置写'\0'
+        *decoded_name = '\0';
+        *decoded_value = '\0';
+        fields[count].name_ = std::string_view(p, decoded_name - p);
+        fields[count].value_ = std::string_view(value, decoded_value - value);
+        ++count;
+        p = field_end + 1;
+    }
+    return count;
+}
+
+std::string_view FindFormValue(const FormField *fields, int count, std::string_view name)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (fields[i].name_ == name)
+            return fields[i].value_;
+    }
+    return std::string_view();
+}
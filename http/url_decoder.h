@@ -0,0 +1,29 @@
+#ifndef HTTP_URL_DECODER_H
+#define HTTP_URL_DECODER_H
+
+#include <string_view>
+
+// URL和application/x-www-form-urlencoded正文的原地解码。
+// 输出不会比输入长，结果直接写回原缓冲区；没有转义的部分由扫描器成批跳过
+
+// 解码[begin, end)中的%xx，plus_as_space为true时把'+'解码为空格。
+// 返回解码后的末尾，转义格式错误或解码出'\0'时返回nullptr
+char *DecodeComponent(char *begin, char *end, bool plus_as_space);
+
+// 解码并规范化以'/'开头的路径[begin, end)：解码%xx，去掉"."段，".."段回退一级。
+// 返回规范化后的末尾，转义错误、解码出'\0'或".."越过根目录时返回nullptr
+char *CanonicalizePath(char *begin, char *end);
+
+// 表单中的一个字段，名字和值都已解码并以'\0'结尾
+struct FormField
+{
+    std::string_view name_;
+    std::string_view value_;
+};
+
+// 原地解析长度为length的表单正文，最多取max_count个字段，返回字段数，编码错误时返回-1
+int ParseForm(char *data, size_t length, FormField *fields, int max_count);
+// 返回名为name的第一个字段的值，没有时返回空串
+std::string_view FindFormValue(const FormField *fields, int count, std::string_view name);
+
+#endif
@@ -1,10 +1,10 @@
 #include <string.h>
-#include <sys/time.h>
 #include <stdarg.h>
 #include <thread>
 #include <ctime>
 
 #include "logger.h"
+#include "time/coarse_clock.h"
 
 Logger::Logger() : count_(0), is_async_(false){};
 
@@ -58,11 +58,9 @@ bool Logger::Initialize(const std::string &file_name,
 void Logger::WriteLog(LogLevel level, const char *format, ...)
 {
     ULock locker(mutex_,std::defer_lock);
-    struct timeval now = {0, 0};
-    gettimeofday(&now, NULL);
-    time_t t = now.tv_sec;
-    struct tm *sys_tm = localtime(&t);
-    struct tm my_tm = *sys_tm;
+    // 时间取自本线程缓存的时钟，秒数不变时不再调用localtime
+    int today = CoarseClock::Today();
+    std::string_view timestamp = CoarseClock::LogTimestamp();
 
     char s[16] = {0};
     switch (level)
@@ -88,16 +86,17 @@ void Logger::WriteLog(LogLevel level, const char *format, ...)
     locker.lock();
     ++count_;
     // 当发现当前时间不等于前次日志时间，或者日志行数超过最大行数时需要新建日志
-    if(today_ != my_tm.tm_mday || count_% split_lines_ ==0)
+    if(today_ != (size_t)today || count_% split_lines_ ==0)
     {
         char new_log_name[256] = {0};
         file_.close();
+        // 时间前缀的前10个字符就是"YYYY-MM-DD"
         char tail[16] = {0};
-        snprintf(tail, 16, "%d_%02d_%02d_", my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday);
-        if(today_!= my_tm.tm_mday)
+        snprintf(tail, 16, "%.4s_%.2s_%.2s_", timestamp.data(), timestamp.data() + 5, timestamp.data() + 8);
+        if(today_!= (size_t)today)
         {
             snprintf(new_log_name, 255, "%s%s%s", dir_name_.c_str(), tail, log_name_.c_str());
-            today_ = my_tm.tm_mday;
+            today_ = today;
             count_ = 0;
         }
         else
@@ -117,9 +116,8 @@ void Logger::WriteLog(LogLevel level, const char *format, ...)
 
     // 写入具体时间
     locker.lock();
-    size_t n = snprintf(buffer_, 48, "%d-%02d-%02d %02d:%02d:%02d.%06ld %s ",
-                    my_tm.tm_year + 1900, my_tm.tm_mon + 1, my_tm.tm_mday,
-                    my_tm.tm_hour, my_tm.tm_min, my_tm.tm_sec, now.tv_usec, s);
+    size_t n = snprintf(buffer_, 48, "%.*s.%06ld %s ",
+                    (int)timestamp.size(), timestamp.data(), CoarseClock::Microseconds(), s);
     size_t m = vsnprintf(buffer_+n, logger_buffer_size_-n-1,format, valist);
     buffer_[m+n] = '\n';
     buffer_[m+n+1] = '\0';
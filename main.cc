@@ -6,36 +6,24 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <signal.h>
 
+#include <algorithm>
 #include <cassert>
+#include <thread>
 #include <vector>
 
 #include "threadpool/thread_pool.h"
 #include "time/lst_time.h"
 #include "http/http_connection.h"
+#include "reactor/reactor.h"
 #include "logger/logger.h"
 #include "cgi/mysql_connect_pool.h"
+#include "cpu/cpu_placement.h"
 
 #include "config.inc"
 
-namespace
-{
-int pipefd[2];
-int epoll_fd = 0;
-SortedTimerList time_list;
-} // namespace
-
-void SigalHandler(int sig)
-{
-    // 为确保可重入，拷贝信号到局部变量
-    int former_errno = errno;
-    int former_sig = sig;
-    // 通过管道发送信号，这里这样做是为了尽量减少信号处理函数的长度，
-    // 避免因为处理时间过长而使其他信号被抛弃，仅仅将信号转发给主程序做处理
-    send(pipefd[1], (char *)&former_sig, 1, 0);
-    errno = former_errno;
-}
-
 void AddSig(int sig, void (*handler)(int), bool restart = true)
 {
     struct sigaction sa;
@@ -46,33 +34,39 @@ void AddSig(int sig, void (*handler)(int), bool restart = true)
     sigfillset(&sa.sa_mask);
     assert(sigaction(sig, &sa, NULL) != -1);
 }
-// 刷新计时队列，再次出发SIGALRM信号
-void TimerHandler()
-{
-    time_list.Tick();
-    alarm(TIMESLOT);
-}
 
-// 计时队列超时时调用的回调函数，负责删除非活动连接,解除epoll注册
-void cb_func(ClientData *user_data)
+// 创建监听socket，多反应堆模式下每个反应堆各自绑定一个SO_REUSEPORT的监听socket，由内核分发连接
+int CreateListenFd(int port, bool reuse_port)
 {
-    assert(user_data);
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, user_data->socket_fd_, nullptr);
-    close(user_data->socket_fd_);
-    HttpConnection::user_count_--;
-    LOG_INFO("Close fd %d", user_data->socket_fd_);
-    Logger::GetInstance()->Flush();
-}
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(listen_fd >= 0);
+    sockaddr_in address;
+    bzero(&address, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
 
-void ShowError(int conn_fd, const char *info)
-{
-    printf("%s", info);
-    send(conn_fd, info, strlen(info), 0);
-    close(conn_fd);
+    int flag = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    if (reuse_port)
+    {
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag));
+    }
+    int ret = bind(listen_fd, (struct sockaddr *)&address, sizeof(address));
+    assert(ret == 0);
+    ret = listen(listen_fd, 5);
+    assert(ret >= 0);
+    return listen_fd;
 }
 
 int main(int argc, char *argv[])
 {
+    // 在创建任何线程之前屏蔽SIGTERM，之后创建的线程都继承该屏蔽字，
+    // 信号只会挂起在进程上，由第0个反应堆通过signalfd读取
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
 
 #ifdef ASYNLOG
     Logger::GetInstance()->Initialize("./mylog.log", 8192, 2000000, 10);
@@ -94,10 +88,12 @@ int main(int argc, char *argv[])
     ConnectPool *conn_pool = ConnectPool::GetInstance(HOST, MYSQL_USR,
                                                       MYSQL_PASSWD, SQL_NAME,
                                                       MYSQL_PORT, MAX_CONNECTION);
-    auto pool = new ThreadPool<HttpConnection>(conn_pool);
-    auto users = new HttpConnection[MAX_FD];
+    // 先读出CPU布局，再创建会绑定自己的线程
+    CpuPlacement *placement = CpuPlacement::GetInstance();
+    auto pool = new ThreadPool<HttpConnection>(conn_pool, THREAD_NUMBER);
+    // 按fd索引的连接表只存指针，连接对象在accept时才由反应堆分配
+    auto clients = new Client *[MAX_FD]();
 
-    int user_count = 0;
 // 初始化数据库读取表
 #ifdef SYNSQL
     HttpConnection::InitMysqlResult(conn_pool);
@@ -106,215 +102,68 @@ int main(int argc, char *argv[])
 #ifdef CGISQLPOOL
     HttpConnection::InitResultFile(conn_pool);
 #endif
-
-    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-    assert(listen_fd >= 0);
-    sockaddr_in address;
-    bzero(&address, sizeof(address));
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = htonl(INADDR_ANY);
-    address.sin_port = htons(port);
-
-    int flag = 1;
-    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
-    int ret = bind(listen_fd, (struct sockaddr *)&address, sizeof(address));
-    assert(ret == 0);
-    assert(listen(listen_fd, 5) >= 0);
-    epoll_event event[MAX_EVENT_NUMBER];
-    int epoll_fd = epoll_create(5);
-    assert(epoll_fd != -1);
-
-    AddFd(epoll_fd, listen_fd, false);
-    HttpConnection::epoll_fd_ = epoll_fd;
-
-    assert(socketpair(PF_UNIX, SOCK_STREAM, 0, pipefd) == 0);
-    // 为了不让信号处理函数时间太长，因此这里只能把管道的写端设置为非阻塞
-    SetNonBlock(pipefd[1]);
-    AddFd(epoll_fd, pipefd[0], false);
-    AddSig(SIGALRM, SigalHandler, false);
-    AddSig(SIGTERM, SigalHandler, false);
-    // 循环条件
-    bool stop_server = false;
-    auto user_timer = new ClientData[MAX_FD];
-    bool time_out = false;
-    alarm(TIMESLOT);
-    while (!stop_server)
+    // 缓存文档根目录下的静态文件
+    HttpConnection::InitFileCache(FILE_CACHE_SIZE);
+
+#if defined(MULTI_REACTOR)
+    int reactor_number = REACTOR_NUMBER > 0 ? REACTOR_NUMBER : placement->CpuCount();
+#elif defined(MAIN_SUB_REACTOR)
+    // 主反应堆占用第0个CPU，从反应堆只用其余的CPU，不与它共用
+    int reactor_number = REACTOR_NUMBER > 0 ? REACTOR_NUMBER : std::max(placement->CpuCount() - 1, 1);
+#else
+    int reactor_number = 1;
+#endif
+    std::vector<Reactor *> reactors;
+#ifdef MAIN_SUB_REACTOR
+    // 主反应堆只负责accept，从反应堆不监听端口
+    reactors.push_back(new Reactor(CreateListenFd(port, false), clients, pool, conn_pool));
+    std::vector<Reactor *> sub_reactors;
+    for (int i = 0; i < reactor_number; ++i)
     {
-        int event_num = epoll_wait(epoll_fd, event, MAX_EVENT_NUMBER, -1);
-        if (event_num < 0 && errno != EINTR)
-        {
-            LOG_ERROR("%s", "epoll failure");
-            break;
-        }
-
-        for (int i = 0; i < event_num; ++i)
-        {
-            int sock_fd = event[i].data.fd;
-            // 收到新连接请求
-            if (sock_fd == listen_fd)
-            {
-                struct sockaddr_in client_address;
-                socklen_t client_length;
-#ifdef LT
-                int conn_fd = accept(listen_fd, (struct sockaddr *)&client_address, &client_length);
-                if (conn_fd < 0)
-                {
-                    LOG_ERROR("%s:errno is:%d", "accept error", errno);
-                    continue;
-                }
-
-                if (HttpConnection::user_count_ >= MAX_FD)
-                {
-                    ShowError(conn_fd, "Internal server busy");
-                    LOG_ERROR("%s", "Internal server busy");
-                    continue;
-                }
-                users[conn_fd].Initialize(conn_fd, client_address);
-
-                user_timer[conn_fd].address_ = client_address;
-                user_timer[conn_fd].socket_fd_ = conn_fd;
-                UtilTimer *timer = new UtilTimer;
-                timer->cb_func_ = cb_func;
-                timer->user_data_ = &user_timer[conn_fd];
-                timer->expire_time_ = time(nullptr) + 3 * TIMESLOT;
-                user_timer[conn_fd].timer_ = timer;
-                time_list.AddTimer(timer);
+        sub_reactors.push_back(new Reactor(-1, clients, pool, conn_pool));
+        reactors.push_back(sub_reactors.back());
+    }
+    reactors[0]->SetSubReactors(sub_reactors);
+#else
+    for (int i = 0; i < reactor_number; ++i)
+    {
+#ifdef MULTI_REACTOR
+        reactors.push_back(new Reactor(CreateListenFd(port, true), clients, pool, conn_pool));
+#else
+        reactors.push_back(new Reactor(CreateListenFd(port, false), clients, pool, conn_pool));
 #endif
-
-#ifdef ET
-                // ET模式需要一次性读完数据
-                while (true)
-                {
-                    int conn_fd = accept(listen_fd, (sockaddr *)&client_address, &client_length);
-                    if (conn_fd < 0)
-                    {
-                        LOG_ERROR("accept error, errno is : %d", errno);
-                        break;
-                    }
-                    if (HttpConnection::user_count_ >= MAX_FD)
-                    {
-                        ShowError(conn_fd, "Internal server busy");
-                        LOG_ERROR("%s", "Internal server busy");
-                        break;
-                    }
-                    users[conn_fd].Initialize(conn_fd, client_address);
-
-                    user_timer[conn_fd].address_ = client_address;
-                    user_timer[conn_fd].socket_fd_ = conn_fd;
-                    UtilTimer *timer = new UtilTimer;
-                    timer->cb_func_ = cb_func;
-                    timer->user_data_ = &user_timer[conn_fd];
-                    timer->expire_time_ = time(nullptr) + 3 * TIMESLOT;
-                    user_timer[conn_fd].timer_ = timer;
-                    time_list.AddTimer(timer);
-                }
-                continue;
+    }
 #endif
-            }
-            else if (event[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
-            {
-                cb_func(&user_timer[sock_fd]);
-                UtilTimer *timer = user_timer[sock_fd].timer_;
-                if (timer)
-                {
-                    time_list.DeleteTimer(timer);
-                }
-            }
-            else if (sock_fd == pipefd[0] && (event[i].events & EPOLLIN))
-            {
-                int sig;
-                char signals[1024];
-                // 此处管道读端的信号只可能是SIGALRM和SIGTREM，即14或15
-                int ret = recv(pipefd[0], signals, sizeof(signals), 0);
-                if (ret == -1)
-                {
-                    continue;
-                }
-                else if (ret == 0)
-                {
-                    continue;
-                }
-                else
-                {
-                    for (int i = 0; i < ret; ++i)
-                    {
-                        if (signals[i] == SIGALRM)
-                        {
-                            time_out = true;
-                            break;
-                        }
-                        else if (signals[i] == SIGTERM)
-                        {
-                            stop_server = true;
-                        }
-                    }
-                }
-            }
-            else if (event[i].events & EPOLLIN)
-            {
-                UtilTimer *timer = user_timer[sock_fd].timer_;
-                if (users[sock_fd].ReadOnce())
-                {
-                    LOG_INFO("deal with client(%s)", inet_ntoa(users[sock_fd].GetAddress()->sin_addr));
-                    Logger::GetInstance()->Flush();
-                    pool->Append(users + sock_fd);
-                    if (timer)
-                    {
-                        timer->expire_time_ = time(nullptr) + 3 * TIMESLOT;
-                        LOG_INFO("%s", "adjust time once");
-                        Logger::GetInstance()->Flush();
-                        time_list.AdjustTimer(timer);
-                    }
-                }
-                else
-                {
-                    timer->cb_func_(&user_timer[sock_fd]);
-                    if (timer)
-                    {
-                        time_list.DeleteTimer(timer);
-                    }
-                }
-            }
-            else if (event[i].events & EPOLLOUT)
-            {
-                UtilTimer *timer = user_timer[sock_fd].timer_;
-                if (users[sock_fd].Write())
-                {
-                    LOG_INFO("send data to the client(%s)", inet_ntoa(users[sock_fd].GetAddress()->sin_addr));
-                    Logger::GetInstance()->Flush();
-                    if (timer)
-                    {
-                        timer->expire_time_ += time(nullptr) + 3 * TIMESLOT;
-                        LOG_INFO("%s", "adjust time once");
-                        Logger::GetInstance()->Flush();
-                        time_list.AdjustTimer(timer);
-                    }
-                }
-                else
-                {
-                    timer->cb_func_(&user_timer[sock_fd]);
-                    if (timer)
-                    {
-                        time_list.DeleteTimer(timer);
-                    }
-                }
-            }
-        }
-        // 完成读写后再处理超时连接
-        if (time_out)
-        {
-            TimerHandler();
-            time_out = false;
-        }
+    int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    assert(signal_fd != -1);
+    reactors[0]->WatchSignals(signal_fd, reactors);
+
+    // 第0个反应堆运行在主线程中，其余各占一个线程，各自绑定后再进入事件循环
+    std::vector<std::thread> reactor_threads;
+    for (size_t i = 1; i < reactors.size(); ++i)
+    {
+        reactor_threads.emplace_back([placement, reactor = reactors[i], i] {
+            placement->PlaceReactor(i);
+            reactor->Loop();
+        });
+    }
+    placement->PlaceReactor(0);
+    // 各线程都已开始绑定，报告它们实际得到的CPU
+    placement->Report(reactors.size(), THREAD_NUMBER);
+    reactors[0]->Loop();
+    for (auto &thread : reactor_threads)
+    {
+        thread.join();
     }
 
-    close(epoll_fd);
-    close(listen_fd);
-    close(pipefd[1]);
-    close(pipefd[0]);
-    delete[] users;
+    // 先停下并等待所有工作线程，它们可能还在处理反应堆中的连接，之后才能释放反应堆和连接
     delete pool;
-    delete[] user_timer;
+    for (Reactor *reactor : reactors)
+    {
+        delete reactor;
+    }
+    close(signal_fd);
+    delete[] clients;
     conn_pool->Destory();
     return 0;
-}
\ No newline at end of file
+}
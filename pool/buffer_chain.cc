@@ -0,0 +1,109 @@
+#include <cstring>
+
+#include "buffer_chain.h"
+
+BufferBlock *BufferChain::AppendBlock(size_t keep)
+{
+    BufferBlock *block = reinterpret_cast<BufferBlock *>(BufferPool::GetInstance()->Acquire());
+    block->next_ = nullptr;
+    block->begin_ = 0;
+    block->end_ = 0;
+    if (tail_)
+    {
+        if (keep < tail_->end_)
+        {
+            block->end_ = tail_->end_ - keep;
+            memcpy(block->Data(), tail_->Data() + keep, block->end_);
+            tail_->end_ = keep;
+        }
+        tail_->next_ = block;
+    }
+    else
+    {
+        head_ = block;
+    }
+    tail_ = block;
+    return block;
+}
+
+char *BufferChain::WritableBegin(size_t *length)
+{
+    if (!tail_ || tail_->end_ >= BUFFER_BLOCK_CAPACITY)
+    {
+        AppendBlock(tail_ ? tail_->end_ : 0);
+    }
+    *length = BUFFER_BLOCK_CAPACITY - tail_->end_;
+    return tail_->Data() + tail_->end_;
+}
+
+void BufferChain::Append(const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t space;
+        char *buffer = WritableBegin(&space);
+        size_t count = length < space ? length : space;
+        memcpy(buffer, data, count);
+        Commit(count);
+        data += count;
+        length -= count;
+    }
+}
+
+void BufferChain::Consume(size_t length)
+{
+    size_ -= length;
+    while (length > 0 && head_)
+    {
+        size_t available = head_->end_ - head_->begin_;
+        if (length < available)
+        {
+            head_->begin_ += length;
+            return;
+        }
+        length -= available;
+        BufferBlock *block = head_;
+        head_ = head_->next_;
+        BufferPool::GetInstance()->Release(reinterpret_cast<char *>(block));
+    }
+    if (!head_)
+    {
+        tail_ = nullptr;
+    }
+}
+
+int BufferChain::FillIovec(struct iovec *iov, int max_count, size_t skip, size_t limit, size_t *length) const
+{
+    int count = 0;
+    *length = 0;
+    for (BufferBlock *block = head_; block && count < max_count && *length < limit; block = block->next_)
+    {
+        size_t available = block->end_ - block->begin_;
+        if (skip >= available)
+        {
+            skip -= available;
+            continue;
+        }
+        available -= skip;
+        if (available > limit - *length)
+            available = limit - *length;
+        iov[count].iov_base = block->Data() + block->begin_ + skip;
+        iov[count].iov_len = available;
+        *length += available;
+        skip = 0;
+        ++count;
+    }
+    return count;
+}
+
+void BufferChain::Clear()
+{
+    while (head_)
+    {
+        BufferBlock *block = head_;
+        head_ = head_->next_;
+        BufferPool::GetInstance()->Release(reinterpret_cast<char *>(block));
+    }
+    tail_ = nullptr;
+    size_ = 0;
+}
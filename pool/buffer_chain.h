@@ -0,0 +1,64 @@
+#ifndef POOL_BUFFERCHAIN_
+#define POOL_BUFFERCHAIN_
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pool/buffer_pool.h"
+
+// 缓冲区链中的一个块。块头放在从BufferPool取得的内存块开头，其后是数据区
+struct BufferBlock
+{
+    BufferBlock *next_;
+    // 数据区中有效数据的起止位置
+    uint32_t begin_, end_;
+    char *Data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+// 每个块数据区的大小
+const size_t BUFFER_BLOCK_CAPACITY = BufferPool::BLOCK_SIZE - sizeof(BufferBlock);
+
+// 由内存块串成的缓冲区，数据超过一个块时向后追加新块而不搬移已有数据。
+// 小请求和小响应只占一个块，块在数据被消费后立即还给缓冲区池
+class BufferChain
+{
+public:
+    BufferChain() : head_(nullptr), tail_(nullptr), size_(0){};
+    ~BufferChain() { Clear(); }
+    BufferChain(const BufferChain &) = delete;
+    BufferChain &operator=(const BufferChain &) = delete;
+
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    BufferBlock *Head() const { return head_; }
+    BufferBlock *Tail() const { return tail_; }
+
+    // 在链尾追加一个空块，原尾块只保留keep之前的数据，其余数据移到新块开头
+    BufferBlock *AppendBlock(size_t keep);
+    // 返回链尾可直接写入的区域及其长度，尾块已满时先追加新块
+    char *WritableBegin(size_t *length);
+    // 确认在WritableBegin返回的区域中写入了length字节
+    void Commit(size_t length)
+    {
+        tail_->end_ += length;
+        size_ += length;
+    }
+    // 追加数据，必要时跨越多个块
+    void Append(const char *data, size_t length);
+    // 从链头丢弃length字节，用完的块还给缓冲区池
+    void Consume(size_t length);
+    // 跳过开头的skip字节，按顺序填入至多max_count个iovec、共至多limit字节，
+    // 返回填入的个数，length为填入的总字节数
+    int FillIovec(struct iovec *iov, int max_count, size_t skip, size_t limit, size_t *length) const;
+    // 释放所有块
+    void Clear();
+
+private:
+    BufferBlock *head_;
+    BufferBlock *tail_;
+    size_t size_;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "cpu/cpu_placement.h"
+#include "logger/logger.h"
+
+namespace
+{
+// 分配按size对齐的size字节匿名内存，失败时返回nullptr
+char *MapAligned(size_t size)
+{
+    // 多映射一倍再裁掉两端，得到对齐的区间
+    void *memory = mmap(nullptr, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return nullptr;
+    uintptr_t begin = reinterpret_cast<uintptr_t>(memory);
+    uintptr_t aligned = (begin + size - 1) & ~(uintptr_t)(size - 1);
+    if (aligned > begin)
+        munmap(memory, aligned - begin);
+    if (begin + 2 * size > aligned + size)
+        munmap(reinterpret_cast<void *>(aligned + size), begin + 2 * size - aligned - size);
+    return reinterpret_cast<char *>(aligned);
+}
+
+// 让区间内的物理页优先分配在系统编号为node_id的节点上，该节点内存不足时仍可使用其他节点
+bool BindToNode(char *memory, size_t size, int node_id)
+{
+    const size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node_id / bits + 1, 0);
+    mask[node_id / bits] |= 1UL << (node_id % bits);
+    return syscall(SYS_mbind, memory, size, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1, 0) == 0;
+}
+} // namespace
+
+BufferPool::BufferPool() : caches_(CpuPlacement::GetInstance()->NodeCount())
+{
+}
+
+BufferPool::~BufferPool()
+{
+    for (NodeCache &cache : caches_)
+    {
+        for (char *slab : cache.slabs_)
+        {
+            munmap(slab, SLAB_SIZE);
+        }
+    }
+}
+
+int BufferPool::NodeOf(const char *block)
+{
+    uintptr_t slab = reinterpret_cast<uintptr_t>(block) & ~(uintptr_t)(SLAB_SIZE - 1);
+    return reinterpret_cast<const SlabHeader *>(slab)->node_;
+}
+
+bool BufferPool::Grow(int node)
+{
+    char *slab = MapAligned(SLAB_SIZE);
+    if (!slab)
+        return false;
+    // 在写入slab头之前设置策略，之后的每一页都按策略分配。只有一个节点或节点编号未知时不必设置
+    CpuPlacement *placement = CpuPlacement::GetInstance();
+    int node_id = placement->NodeId(node);
+    if (placement->NodeCount() > 1 && node_id >= 0 && !BindToNode(slab, SLAB_SIZE, node_id))
+        LOG_WARN("mbind buffer slab to node %d failed, errno is: %d", node_id, errno);
+    reinterpret_cast<SlabHeader *>(slab)->node_ = node;
+    NodeCache &cache = caches_[node];
+    cache.slabs_.push_back(slab);
+    // 倒序放入，先取出的是地址低的块
+    for (size_t offset = SLAB_SIZE - BLOCK_SIZE; offset >= BLOCK_SIZE; offset -= BLOCK_SIZE)
+    {
+        cache.free_blocks_.push_back(slab + offset);
+    }
+    return true;
+}
+
+char *BufferPool::Acquire()
+{
+    int node = CpuPlacement::GetInstance()->CurrentNode();
+    NodeCache &cache = caches_[node];
+    std::lock_guard<std::mutex> locker(cache.mutex_);
+    if (cache.free_blocks_.empty() && !Grow(node))
+        throw std::bad_alloc();
+    char *block = cache.free_blocks_.back();
+    cache.free_blocks_.pop_back();
+    return block;
+}
+
+void BufferPool::Release(char *block)
+{
+    if (!block)
+        return;
+    NodeCache &cache = caches_[NodeOf(block)];
+    {
+        std::lock_guard<std::mutex> locker(cache.mutex_);
+        if (cache.free_blocks_.size() < MAX_CACHED_BLOCKS)
+        {
+            cache.free_blocks_.push_back(block);
+            return;
+        }
+    }
+    // 空闲块太多时在锁外交还物理页，再次取出时按slab的策略在原节点上重新分配
+    madvise(block, BLOCK_SIZE, MADV_DONTNEED);
+    std::lock_guard<std::mutex> locker(cache.mutex_);
+    cache.free_blocks_.push_back(block);
+}
@@ -0,0 +1,58 @@
+#ifndef POOL_BUFFERPOOL_
+#define POOL_BUFFERPOOL_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// 所有连接共用的定长内存块池，连接只在有数据收发时才持有内存块。
+// 块从按节点分配的slab中切出：每个NUMA节点一条空闲链表，slab用mmap分配后以mbind指定本节点，
+// 物理页无论由哪个线程首先写入都分配在该节点上。块归还到它所属slab的节点而不是归还线程所在的节点，
+// 工作线程填好、反应堆释放的块仍回到原节点。块可能在不同线程取出和归还，因此每条链表各用一个互斥锁保护
+class BufferPool
+{
+public:
+    static const size_t BLOCK_SIZE = 4096;
+    // slab的大小，按自身大小对齐，块所属的slab由地址直接算出；slab的第一个块存放slab头
+    static const size_t SLAB_SIZE = 2 * 1024 * 1024;
+    // 每个节点最多保留物理内存的空闲块数，超过后归还的块交还物理页，地址仍留在链表中
+    static const size_t MAX_CACHED_BLOCKS = 4096;
+
+    // 采用局部静态对象实现的单例
+    static BufferPool *GetInstance()
+    {
+        static BufferPool instance;
+        return &instance;
+    }
+
+    // 从当前线程所在节点取出一个BLOCK_SIZE字节的块，内容未初始化
+    char *Acquire();
+    // 把块归还到分配它的节点
+    void Release(char *block);
+
+private:
+    BufferPool();
+    ~BufferPool();
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    struct SlabHeader
+    {
+        // 所属节点的下标
+        int node_;
+    };
+    struct alignas(64) NodeCache
+    {
+        std::mutex mutex_;
+        std::vector<char *> free_blocks_;
+        std::vector<char *> slabs_;
+    };
+    // 为节点分配一个slab并把其中的块放入空闲链表，须持有该节点的锁
+    bool Grow(int node);
+    static int NodeOf(const char *block);
+
+    // 按CpuPlacement的节点下标索引
+    std::vector<NodeCache> caches_;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef POOL_OBJECTPOOL_
+#define POOL_OBJECTPOOL_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// 定长对象池：归还的对象只析构、不释放内存，下次取出时在原内存上重新构造。
+// 空闲内存超过max_cached个时才真正释放，因此常驻内存随活跃对象数变化而不是按上限预分配。
+// 不加锁，只能由一个线程使用
+template <class T>
+class ObjectPool
+{
+public:
+    explicit ObjectPool(size_t max_cached) : free_list_(nullptr), cached_(0), max_cached_(max_cached) {}
+    ~ObjectPool()
+    {
+        while (free_list_)
+        {
+            Node *node = free_list_;
+            free_list_ = node->next_;
+            ::operator delete(node);
+        }
+    }
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    // 取出一个对象，参数转发给T的构造函数
+    template <class... Args>
+    T *Acquire(Args &&... args)
+    {
+        void *memory;
+        if (free_list_)
+        {
+            memory = free_list_;
+            free_list_ = free_list_->next_;
+            --cached_;
+        }
+        else
+        {
+            memory = ::operator new(sizeof(Storage));
+        }
+        return new (memory) T(std::forward<Args>(args)...);
+    }
+
+    // 析构对象并回收其内存
+    void Release(T *object)
+    {
+        object->~T();
+        if (cached_ >= max_cached_)
+        {
+            ::operator delete(object);
+            return;
+        }
+        Node *node = reinterpret_cast<Node *>(object);
+        node->next_ = free_list_;
+        free_list_ = node;
+        ++cached_;
+    }
+
+private:
+    // 空闲内存复用为链表节点
+    struct Node
+    {
+        Node *next_;
+    };
+    union Storage {
+        Node node_;
+        alignas(T) unsigned char object_[sizeof(T)];
+    };
+
+    Node *free_list_;
+    size_t cached_;
+    size_t max_cached_;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "io_uring.h"
+
+namespace
+{
+int SysIoUringSetup(unsigned entries, io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int SysIoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+int SysIoUringRegister(int ring_fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+} // namespace
+
+IoUring::IoUring()
+    : ring_fd_(-1), sqes_(nullptr), sq_local_tail_(0), cqes_(nullptr),
+      sq_ring_(MAP_FAILED), sq_ring_size_(0), cq_ring_(MAP_FAILED), cq_ring_size_(0),
+      sqes_size_(0), buf_ring_(nullptr), buf_ring_tail_(nullptr), buf_ring_size_(0),
+      buf_ring_mask_(0), buffers_(nullptr), buffer_size_(0){};
+
+IoUring::~IoUring()
+{
+    if (buf_ring_)
+        munmap(buf_ring_, buf_ring_size_);
+    delete[] buffers_;
+    if (sqes_)
+        munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+        munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED)
+        munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ != -1)
+        close(ring_fd_);
+}
+
+bool IoUring::Initialize(unsigned entries)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // 完成事件在线程下次进入内核时再处理，避免内核为投递完成事件打断反应堆线程
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    ring_fd_ = SysIoUringSetup(entries, &params);
+    if (ring_fd_ < 0 && errno == EINVAL)
+    {
+        params.flags = 0;
+        ring_fd_ = SysIoUringSetup(entries, &params);
+    }
+    if (ring_fd_ < 0)
+        return false;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && cq_ring_size_ > sq_ring_size_)
+        sq_ring_size_ = cq_ring_size_;
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED)
+        return false;
+    if (single_mmap)
+    {
+        cq_ring_ = sq_ring_;
+    }
+    else
+    {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED)
+            return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sq_local_tail_ = *sq_tail_;
+
+    char *cq = static_cast<char *>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::RegisterBufferRing(uint16_t group_id, unsigned entries, unsigned buffer_size)
+{
+    buf_ring_size_ = entries * sizeof(io_uring_buf);
+    void *ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED)
+        return false;
+    buf_ring_ = static_cast<io_uring_buf *>(ring);
+    buf_ring_tail_ = &buf_ring_[0].resv;
+
+    buf_ring_mask_ = entries - 1;
+    buffer_size_ = buffer_size;
+    buffers_ = new char[(size_t)entries * buffer_size];
+    *buf_ring_tail_ = 0;
+    for (unsigned i = 0; i < entries; ++i)
+    {
+        RecycleBuffer(i);
+    }
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = entries;
+    reg.bgid = group_id;
+    if (SysIoUringRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return false;
+    return true;
+}
+
+void IoUring::RecycleBuffer(uint16_t buffer_id)
+{
+    uint16_t tail = *buf_ring_tail_;
+    io_uring_buf *buf = &buf_ring_[tail & buf_ring_mask_];
+    buf->addr = reinterpret_cast<uint64_t>(GetBuffer(buffer_id));
+    buf->len = buffer_size_;
+    buf->bid = buffer_id;
+    __atomic_store_n(buf_ring_tail_, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+io_uring_sqe *IoUring::GetSqe()
+{
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head > *sq_mask_)
+    {
+        // 提交队列已满，先交给内核
+        SubmitAndWait(0);
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    }
+    unsigned index = sq_local_tail_ & *sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    return sqe;
+}
+
+void IoUring::PrepMultishotAccept(int listen_fd, uint64_t user_data)
+{
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+}
+
+void IoUring::PrepMultishotRecv(int fd, uint16_t group_id, uint64_t user_data)
+{
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group_id;
+    sqe->user_data = user_data;
+}
+
+void IoUring::PrepSendmsg(int fd, const msghdr *msg, unsigned flags, uint64_t user_data)
+{
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = user_data;
+}
+
+void IoUring::PrepRead(int fd, void *buffer, unsigned length, uint64_t user_data)
+{
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    // signalfd、timerfd和eventfd没有文件偏移
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = user_data;
+}
+
+void IoUring::PrepPollAdd(int fd, unsigned events, uint64_t user_data)
+{
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void IoUring::PrepCancelFd(int fd, uint64_t user_data)
+{
+    io_uring_sqe *sqe = GetSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = user_data;
+}
+
+int IoUring::SubmitAndWait(unsigned wait_number)
+{
+    unsigned to_submit = sq_local_tail_ - *sq_tail_;
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    unsigned flags = wait_number > 0 ? IORING_ENTER_GETEVENTS : 0;
+    if (to_submit == 0 && wait_number == 0)
+        return 0;
+    return SysIoUringEnter(ring_fd_, to_submit, wait_number, flags);
+}
+
+io_uring_cqe *IoUring::PeekCqe()
+{
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        return nullptr;
+    return &cqes_[head & *cq_mask_];
+}
+
+void IoUring::SeenCqe()
+{
+    __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,72 @@
+#ifndef REACTOR_IOURING_
+#define REACTOR_IOURING_
+
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// 直接基于io_uring系统调用的最小封装，只提供反应堆用到的操作：
+// 多次触发的accept和recv、提供缓冲区环、sendmsg、read、poll以及按fd取消
+class IoUring
+{
+public:
+    IoUring();
+    ~IoUring();
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    // 创建提交/完成队列，失败返回false
+    bool Initialize(unsigned entries);
+    // 注册一组提供给内核的接收缓冲区，每个buffer_size字节，entries须为2的幂
+    bool RegisterBufferRing(uint16_t group_id, unsigned entries, unsigned buffer_size);
+    // 由缓冲区编号取得缓冲区地址
+    char *GetBuffer(uint16_t buffer_id) { return buffers_ + (size_t)buffer_id * buffer_size_; }
+    // 把用完的缓冲区还给内核
+    void RecycleBuffer(uint16_t buffer_id);
+
+    void PrepMultishotAccept(int listen_fd, uint64_t user_data);
+    void PrepMultishotRecv(int fd, uint16_t group_id, uint64_t user_data);
+    void PrepSendmsg(int fd, const msghdr *msg, unsigned flags, uint64_t user_data);
+    void PrepRead(int fd, void *buffer, unsigned length, uint64_t user_data);
+    // 等待fd上的events事件，只触发一次
+    void PrepPollAdd(int fd, unsigned events, uint64_t user_data);
+    // 取消fd上所有未完成的请求
+    void PrepCancelFd(int fd, uint64_t user_data);
+
+    // 提交所有已准备的请求，并等待至少wait_number个完成事件
+    int SubmitAndWait(unsigned wait_number);
+    // 取出下一个完成事件，没有则返回nullptr；处理完后必须调用SeenCqe
+    io_uring_cqe *PeekCqe();
+    void SeenCqe();
+
+private:
+    // 取得一个空闲的提交项，提交队列已满时先提交
+    io_uring_sqe *GetSqe();
+
+    int ring_fd_;
+    // 提交队列
+    unsigned *sq_head_, *sq_tail_, *sq_mask_, *sq_array_;
+    io_uring_sqe *sqes_;
+    unsigned sq_local_tail_;
+    // 完成队列
+    unsigned *cq_head_, *cq_tail_, *cq_mask_;
+    io_uring_cqe *cqes_;
+    // mmap得到的区域，析构时释放
+    void *sq_ring_;
+    size_t sq_ring_size_;
+    void *cq_ring_;
+    size_t cq_ring_size_;
+    size_t sqes_size_;
+    // 提供缓冲区环。C++下io_uring_buf_ring中柔性数组的偏移与内核不一致，
+    // 因此直接按io_uring_buf数组访问，环尾与第0项的resv字段重叠
+    io_uring_buf *buf_ring_;
+    uint16_t *buf_ring_tail_;
+    size_t buf_ring_size_;
+    unsigned buf_ring_mask_;
+    char *buffers_;
+    unsigned buffer_size_;
+};
+
+#endif
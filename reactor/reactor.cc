@@ -0,0 +1,771 @@
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include "reactor.h"
+#include "logger/logger.h"
+#include "time/coarse_clock.h"
+
+#include "config.inc"
+
+namespace
+{
+// 计时队列超时时调用的回调函数，负责删除非活动连接,解除epoll注册
+void cb_func(ClientData *user_data)
+{
+    assert(user_data);
+    user_data->reactor_->ReleaseClient(user_data);
+}
+
+void ShowError(int conn_fd, const char *info)
+{
+    printf("%s", info);
+    send(conn_fd, info, strlen(info), 0);
+    close(conn_fd);
+}
+} // namespace
+
+Reactor::Reactor(int listen_fd,
+                 Client **clients,
+                 ThreadPool<HttpConnection> *pool,
+                 ConnectPool *conn_pool)
+    : listen_fd_(listen_fd),
+      time_list_(TIMER_TICK_MS),
+      timer_armed_(false),
+      signal_fd_(-1),
+      stop_(false),
+      clients_(clients),
+      client_pool_(CLIENT_CACHE_NUMBER),
+      pool_(pool),
+      conn_pool_(conn_pool),
+      handoff_queue_(HANDOFF_QUEUE_SIZE),
+      connection_count_(0),
+      next_sub_reactor_(0)
+{
+#ifdef IO_URING
+    // 监听socket、timerfd和eventfd都由io_uring读取，保持阻塞即可
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    assert(timer_fd_ != -1);
+    epoll_fd_ = -1;
+    events_ = nullptr;
+    wakeup_fd_ = eventfd(0, EFD_CLOEXEC);
+    assert(wakeup_fd_ != -1);
+    bool ready = ring_.Initialize(URING_ENTRIES) &&
+                 ring_.RegisterBufferRing(0, URING_BUFFER_NUMBER, URING_BUFFER_SIZE);
+    if (!ready)
+    {
+        LOG_ERROR("io_uring setup failed, errno is: %d", errno);
+    }
+    assert(ready);
+#else
+    epoll_fd_ = epoll_create(5);
+    assert(epoll_fd_ != -1);
+    events_ = new epoll_event[MAX_EVENT_NUMBER];
+    if (listen_fd_ != -1)
+    {
+        AddFd(epoll_fd_, listen_fd_, false);
+    }
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(wakeup_fd_ != -1);
+    AddFd(epoll_fd_, wakeup_fd_, false);
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    assert(timer_fd_ != -1);
+    AddFd(epoll_fd_, timer_fd_, false);
+#endif
+}
+
+Reactor::~Reactor()
+{
+    // 关闭仍由本反应堆管理的连接，归还连接对象
+    for (int fd = 0; fd < MAX_FD; ++fd)
+    {
+        if (clients_[fd] && clients_[fd]->user_data_.reactor_ == this)
+        {
+            time_list_.RemoveTimer(&clients_[fd]->user_data_.timer_);
+            FreeClient(fd);
+            close(fd);
+        }
+    }
+#ifndef IO_URING
+    close(epoll_fd_);
+#endif
+    if (listen_fd_ != -1)
+    {
+        close(listen_fd_);
+    }
+    close(wakeup_fd_);
+    close(timer_fd_);
+    delete[] events_;
+}
+
+void Reactor::Loop()
+{
+#ifdef IO_URING
+    UringLoop();
+    return;
+#endif
+    bool time_out = false;
+    while (!stop_)
+    {
+        int event_num = epoll_wait(epoll_fd_, events_, MAX_EVENT_NUMBER, -1);
+        if (event_num < 0 && errno != EINTR)
+        {
+            LOG_ERROR("%s", "epoll failure");
+            break;
+        }
+        // 本轮事件的处理都使用醒来时的时间
+        CoarseClock::Refresh();
+
+        for (int i = 0; i < event_num; ++i)
+        {
+            int sock_fd = events_[i].data.fd;
+            // 收到新连接请求
+            if (sock_fd == listen_fd_)
+            {
+                DealWithAccept();
+            }
+            // 主反应堆交来了新连接
+            else if (sock_fd == wakeup_fd_)
+            {
+                DealWithHandoff();
+            }
+            else if (sock_fd == timer_fd_)
+            {
+                uint64_t expirations;
+                read(timer_fd_, &expirations, sizeof(expirations));
+                time_out = true;
+            }
+            else if (sock_fd == signal_fd_)
+            {
+                signalfd_siginfo info;
+                if (read(signal_fd_, &info, sizeof(info)) == sizeof(info))
+                    DealWithSignal(info.ssi_signo);
+            }
+            else if (events_[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            {
+                CloseClient(sock_fd);
+            }
+            else if (events_[i].events & EPOLLIN)
+            {
+                DealWithRead(sock_fd);
+            }
+            else if (events_[i].events & EPOLLOUT)
+            {
+                DealWithWrite(sock_fd);
+            }
+        }
+        // 完成读写后再处理超时连接
+        if (time_out)
+        {
+            DealWithTimeout();
+            time_out = false;
+        }
+    }
+}
+
+void Reactor::WatchSignals(int signal_fd, const std::vector<Reactor *> &reactors)
+{
+    signal_fd_ = signal_fd;
+    stop_targets_ = reactors;
+#ifndef IO_URING
+    AddFd(epoll_fd_, signal_fd_, false);
+#endif
+}
+
+void Reactor::Stop()
+{
+    stop_ = true;
+    eventfd_write(wakeup_fd_, 1);
+}
+
+void Reactor::DealWithAccept()
+{
+    struct sockaddr_in client_address;
+    socklen_t client_length = sizeof(client_address);
+#ifdef LT
+    int conn_fd = accept(listen_fd_, (struct sockaddr *)&client_address, &client_length);
+    if (conn_fd < 0)
+    {
+        LOG_ERROR("%s:errno is:%d", "accept error", errno);
+        return;
+    }
+    if (HttpConnection::user_count_ >= MAX_FD)
+    {
+        ShowError(conn_fd, "Internal server busy");
+        LOG_ERROR("%s", "Internal server busy");
+        return;
+    }
+    DispatchClient(conn_fd, client_address);
+#endif
+
+#ifdef ET
+    // ET模式需要一次性读完数据
+    while (true)
+    {
+        int conn_fd = accept(listen_fd_, (sockaddr *)&client_address, &client_length);
+        if (conn_fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                LOG_ERROR("accept error, errno is : %d", errno);
+            break;
+        }
+        if (HttpConnection::user_count_ >= MAX_FD)
+        {
+            ShowError(conn_fd, "Internal server busy");
+            LOG_ERROR("%s", "Internal server busy");
+            break;
+        }
+        DispatchClient(conn_fd, client_address);
+    }
+#endif
+}
+
+void Reactor::DealWithHandoff()
+{
+    // eventfd只用于唤醒，读出计数后取空队列即可；io_uring后端已经读过了
+#ifndef IO_URING
+    eventfd_t count;
+    eventfd_read(wakeup_fd_, &count);
+#endif
+    PendingConnection pending;
+    while (handoff_queue_.Pop(pending))
+    {
+        AddClient(pending.socket_fd_, pending.address_);
+    }
+}
+
+void Reactor::DealWithSignal(int sig)
+{
+    // signalfd只接收SIGTERM，通知所有反应堆退出事件循环
+    if (sig == SIGTERM)
+    {
+        for (Reactor *reactor : stop_targets_)
+        {
+            reactor->Stop();
+        }
+    }
+}
+
+void Reactor::DealWithTimeout()
+{
+    SweepDeferred();
+    // 时间轮空了且没有等待回收的连接就停下timerfd，空闲的反应堆不再被周期性唤醒
+    if (!time_list_.Tick(CoarseClock::Milliseconds()) && deferred_.empty())
+        ArmTimer(false);
+}
+
+void Reactor::ArmTimer(bool enable)
+{
+    if (timer_armed_ == enable)
+        return;
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (enable)
+    {
+        spec.it_interval.tv_sec = TIMER_TICK_MS / 1000;
+        spec.it_interval.tv_nsec = TIMER_TICK_MS % 1000 * 1000000L;
+        spec.it_value = spec.it_interval;
+    }
+    timerfd_settime(timer_fd_, 0, &spec, nullptr);
+    timer_armed_ = enable;
+}
+
+void Reactor::DealWithRead(int sock_fd)
+{
+    HttpConnection &conn = clients_[sock_fd]->connection_;
+    if (conn.ReadOnce())
+    {
+        LOG_INFO("deal with client(%s)", inet_ntoa(conn.GetAddress()->sin_addr));
+        Logger::GetInstance()->Flush();
+        // 线程池队列满时直接断开连接卸载负载，否则连接一直等到超时
+        if (!Dispatch(sock_fd))
+        {
+            LOG_WARN("%s", "thread pool queue full, drop connection");
+            CloseClient(sock_fd);
+            return;
+        }
+        RefreshTimer(sock_fd);
+    }
+    else
+    {
+        CloseClient(sock_fd);
+    }
+}
+
+void Reactor::DealWithWrite(int sock_fd)
+{
+    HttpConnection &conn = clients_[sock_fd]->connection_;
+    HttpConnection::WriteResult result = conn.Write();
+    if (result == HttpConnection::WRITE_ERROR)
+    {
+        CloseClient(sock_fd);
+        return;
+    }
+    LOG_INFO("send data to the client(%s)", inet_ntoa(conn.GetAddress()->sin_addr));
+    Logger::GetInstance()->Flush();
+    RefreshTimer(sock_fd);
+    // 流水线中已经收到的后续请求在响应全部发出后直接交给工作线程，不必等待新的读事件。
+    // 响应还没发完时连接仍在等待可写，工作线程既不能改写它的事件注册，也不能与下一次发送同时访问缓冲区链
+    if (result == HttpConnection::WRITE_DONE && conn.HasBufferedInput() && !Dispatch(sock_fd))
+    {
+        LOG_WARN("%s", "thread pool queue full, drop connection");
+        CloseClient(sock_fd);
+    }
+}
+
+void Reactor::RefreshTimer(int sock_fd)
+{
+    UtilTimer &timer = clients_[sock_fd]->user_data_.timer_;
+    if (timer.Pending())
+    {
+        timer.expire_time_ = CoarseClock::Milliseconds() + IDLE_TIMEOUT_MS;
+        LOG_INFO("%s", "adjust time once");
+        Logger::GetInstance()->Flush();
+        time_list_.AdjustTimer(&timer);
+    }
+}
+
+bool Reactor::Handoff(int conn_fd, const sockaddr_in &address)
+{
+    PendingConnection pending;
+    pending.socket_fd_ = conn_fd;
+    pending.address_ = address;
+    if (!handoff_queue_.Push(pending))
+        return false;
+    // 在主反应堆一侧计数，使最少连接分发能看到尚在队列中的连接
+    ++connection_count_;
+    eventfd_write(wakeup_fd_, 1);
+    return true;
+}
+
+void Reactor::DispatchClient(int conn_fd, const sockaddr_in &address)
+{
+    if (sub_reactors_.empty())
+    {
+        ++connection_count_;
+        AddClient(conn_fd, address);
+        return;
+    }
+    size_t target;
+#ifdef LEAST_LOADED_DISPATCH
+    // 交给当前连接数最少的从反应堆
+    target = 0;
+    for (size_t i = 1; i < sub_reactors_.size(); ++i)
+    {
+        if (sub_reactors_[i]->GetConnectionCount() < sub_reactors_[target]->GetConnectionCount())
+            target = i;
+    }
+#else
+    // 轮询
+    target = next_sub_reactor_++ % sub_reactors_.size();
+#endif
+    // 目标队列已满时依次尝试其他从反应堆，全部满则拒绝连接
+    for (size_t i = 0; i < sub_reactors_.size(); ++i)
+    {
+        if (sub_reactors_[(target + i) % sub_reactors_.size()]->Handoff(conn_fd, address))
+            return;
+    }
+    ShowError(conn_fd, "Internal server busy");
+    LOG_ERROR("%s", "Handoff queue full");
+}
+
+void Reactor::AddClient(int conn_fd, const sockaddr_in &address)
+{
+    Client *client = client_pool_.Acquire();
+    clients_[conn_fd] = client;
+    client->connection_.Initialize(conn_fd, address, epoll_fd_);
+#ifdef IO_URING
+    client->uring_.receiving_ = true;
+    client->uring_.sending_ = false;
+    client->uring_.closing_ = false;
+    ring_.PrepMultishotRecv(conn_fd, 0, MakeUserData(URING_RECV, conn_fd));
+#endif
+
+    ClientData &user_data = client->user_data_;
+    user_data.address_ = address;
+    user_data.socket_fd_ = conn_fd;
+    user_data.reactor_ = this;
+    // 定时器是连接对象的一部分，随对象池复用，不另外分配
+    UtilTimer &timer = user_data.timer_;
+    timer.cb_func_ = cb_func;
+    timer.user_data_ = &user_data;
+    time_t now = CoarseClock::Milliseconds();
+    timer.expire_time_ = now + IDLE_TIMEOUT_MS;
+    // timerfd停着时时间轮没有推进，先让它追上当前时间
+    if (!timer_armed_)
+    {
+        time_list_.Tick(now);
+        ArmTimer(true);
+    }
+    time_list_.AddTimer(&timer);
+}
+
+void Reactor::ReleaseClient(ClientData *user_data)
+{
+#ifdef IO_URING
+    // 先取消连接上未完成的请求，全部结束后再由UringFinishClose关闭
+    UringClient &client = clients_[user_data->socket_fd_]->uring_;
+    client.closing_ = true;
+    if (client.receiving_ || client.sending_)
+        ring_.PrepCancelFd(user_data->socket_fd_, MakeUserData(URING_CANCEL, user_data->socket_fd_));
+    else
+        UringFinishClose(user_data->socket_fd_);
+#else
+    int sock_fd = user_data->socket_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, sock_fd, nullptr);
+    // 工作线程还在处理时连接对象和fd都不能释放，只停止监听，处理完后再回收。
+    // 其间工作线程重新注册事件的epoll_ctl会因fd已不在兴趣列表中而失败
+    if (clients_[sock_fd]->connection_.in_flight_.load(std::memory_order_acquire) > 0)
+    {
+        deferred_.push_back(sock_fd);
+        ArmTimer(true);
+        return;
+    }
+    FinishClose(sock_fd);
+#endif
+}
+
+void Reactor::FinishClose(int sock_fd)
+{
+    FreeClient(sock_fd);
+    close(sock_fd);
+    HttpConnection::user_count_--;
+    --connection_count_;
+    LOG_INFO("Close fd %d", sock_fd);
+    Logger::GetInstance()->Flush();
+}
+
+void Reactor::SweepDeferred()
+{
+    size_t kept = 0;
+    for (int sock_fd : deferred_)
+    {
+        if (clients_[sock_fd]->connection_.in_flight_.load(std::memory_order_acquire) > 0)
+            deferred_[kept++] = sock_fd;
+        else
+            FinishClose(sock_fd);
+    }
+    deferred_.resize(kept);
+}
+
+bool Reactor::Dispatch(int sock_fd)
+{
+    HttpConnection &conn = clients_[sock_fd]->connection_;
+    conn.in_flight_.fetch_add(1, std::memory_order_relaxed);
+    if (pool_->Append(&conn))
+        return true;
+    conn.in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Reactor::CloseClient(int sock_fd)
+{
+    Client *client = clients_[sock_fd];
+#ifdef IO_URING
+    if (client->uring_.closing_)
+        return;
+#endif
+    // 先取消定时器，ReleaseClient可能已经归还了连接对象
+    time_list_.RemoveTimer(&client->user_data_.timer_);
+    ReleaseClient(&client->user_data_);
+}
+
+void Reactor::FreeClient(int sock_fd)
+{
+    // 必须在关闭fd之前调用：fd关闭后可能立即被其他反应堆accept复用并写入连接表
+    client_pool_.Release(clients_[sock_fd]);
+    clients_[sock_fd] = nullptr;
+}
+
+#ifdef IO_URING
+
+void Reactor::UringLoop()
+{
+    bool time_out = false;
+    if (listen_fd_ != -1)
+    {
+        ring_.PrepMultishotAccept(listen_fd_, MakeUserData(URING_ACCEPT, listen_fd_));
+    }
+    if (signal_fd_ != -1)
+    {
+        ring_.PrepRead(signal_fd_, &signal_info_, sizeof(signal_info_), MakeUserData(URING_SIGNAL, signal_fd_));
+    }
+    ring_.PrepRead(timer_fd_, &timer_count_, sizeof(timer_count_), MakeUserData(URING_TIMER, timer_fd_));
+    ring_.PrepRead(wakeup_fd_, &wakeup_count_, sizeof(wakeup_count_), MakeUserData(URING_WAKEUP, wakeup_fd_));
+    while (!stop_)
+    {
+        // 一次系统调用既提交上一轮准备的请求，又等待新的完成事件
+        int ret = ring_.SubmitAndWait(1);
+        if (ret < 0 && errno != EINTR)
+        {
+            LOG_ERROR("%s", "io_uring_enter failure");
+            break;
+        }
+        CoarseClock::Refresh();
+        io_uring_cqe *cqe;
+        while ((cqe = ring_.PeekCqe()) != nullptr)
+        {
+            UringDispatch(cqe, time_out);
+            ring_.SeenCqe();
+        }
+        // 完成读写后再处理超时连接
+        if (time_out)
+        {
+            DealWithTimeout();
+            time_out = false;
+        }
+    }
+}
+
+void Reactor::UringDispatch(io_uring_cqe *cqe, bool &time_out)
+{
+    int fd = (int)(uint32_t)cqe->user_data;
+    switch ((UringEvent)(cqe->user_data >> 32))
+    {
+    case URING_ACCEPT:
+        UringAccept(cqe);
+        break;
+    case URING_RECV:
+        UringReceive(fd, cqe);
+        break;
+    case URING_SEND:
+        UringSendComplete(fd, cqe->res);
+        break;
+    case URING_WRITABLE:
+        UringWritable(fd, cqe->res);
+        break;
+    case URING_SIGNAL:
+        if (cqe->res == sizeof(signal_info_))
+            DealWithSignal(signal_info_.ssi_signo);
+        ring_.PrepRead(signal_fd_, &signal_info_, sizeof(signal_info_), cqe->user_data);
+        break;
+    case URING_TIMER:
+        time_out = true;
+        ring_.PrepRead(timer_fd_, &timer_count_, sizeof(timer_count_), cqe->user_data);
+        break;
+    case URING_WAKEUP:
+        DealWithHandoff();
+        ring_.PrepRead(wakeup_fd_, &wakeup_count_, sizeof(wakeup_count_), cqe->user_data);
+        break;
+    case URING_CANCEL:
+    default:
+        break;
+    }
+}
+
+void Reactor::UringAccept(io_uring_cqe *cqe)
+{
+    int conn_fd = cqe->res;
+    if (conn_fd >= 0)
+    {
+        struct sockaddr_in client_address;
+        socklen_t client_length = sizeof(client_address);
+        getpeername(conn_fd, (struct sockaddr *)&client_address, &client_length);
+        if (HttpConnection::user_count_ >= MAX_FD)
+        {
+            ShowError(conn_fd, "Internal server busy");
+            LOG_ERROR("%s", "Internal server busy");
+        }
+        else
+        {
+            DispatchClient(conn_fd, client_address);
+        }
+    }
+    else
+    {
+        LOG_ERROR("accept error, errno is : %d", -conn_fd);
+    }
+    // 内核结束了多次触发的accept，需要重新提交
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+    {
+        ring_.PrepMultishotAccept(listen_fd_, cqe->user_data);
+    }
+}
+
+void Reactor::UringReceive(int sock_fd, io_uring_cqe *cqe)
+{
+    UringClient &client = clients_[sock_fd]->uring_;
+    if (cqe->flags & IORING_CQE_F_BUFFER)
+    {
+        uint16_t buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe->res > 0 && !client.closing_)
+        {
+            UringHandleInput(sock_fd, ring_.GetBuffer(buffer_id), cqe->res);
+        }
+        ring_.RecycleBuffer(buffer_id);
+    }
+    if (cqe->flags & IORING_CQE_F_MORE)
+        return;
+
+    client.receiving_ = false;
+    if (client.closing_)
+    {
+        if (!client.sending_)
+            UringFinishClose(sock_fd);
+    }
+    else if (cqe->res > 0 || cqe->res == -ENOBUFS)
+    {
+        // 接收缓冲区暂时用完或内核主动结束，重新提交即可
+        client.receiving_ = true;
+        ring_.PrepMultishotRecv(sock_fd, 0, cqe->user_data);
+    }
+    else
+    {
+        // 对端关闭连接或出错
+        CloseClient(sock_fd);
+    }
+}
+
+void Reactor::UringHandleInput(int sock_fd, const char *data, size_t length)
+{
+    UringClient &client = clients_[sock_fd]->uring_;
+    if (client.sending_)
+    {
+        // 多次触发的recv无法反压，对端只发不收时与读缓冲区链一样按MAX_BUFFERED_INPUT断开
+        if (client.pending_input_.size() + length > (size_t)HttpConnection::MAX_BUFFERED_INPUT)
+        {
+            LOG_WARN("%s", "too much input buffered while sending, close connection");
+            CloseClient(sock_fd);
+            return;
+        }
+        client.pending_input_.append(data, length);
+        return;
+    }
+    HttpConnection &conn = clients_[sock_fd]->connection_;
+    if (!conn.AppendInput(data, length))
+    {
+        CloseClient(sock_fd);
+        return;
+    }
+    RefreshTimer(sock_fd);
+    UringProcess(sock_fd);
+}
+
+void Reactor::UringProcess(int sock_fd)
+{
+    HttpConnection &conn = clients_[sock_fd]->connection_;
+    // 在反应堆线程内直接解析并生成响应。登录和注册的数据库查询也在这里同步执行，
+    // 查询期间本反应堆不处理其他连接
+    conn.mysql_ = conn_pool_->GetConnetion();
+    HttpConnection::ProcessResult result = conn.ProcessRequest();
+    conn_pool_->ReleaseConnection(conn.mysql_);
+    if (result == HttpConnection::PROCESS_RESPONSE)
+    {
+        UringSend(sock_fd);
+    }
+    else if (result == HttpConnection::PROCESS_ERROR)
+    {
+        CloseClient(sock_fd);
+    }
+}
+
+void Reactor::UringSend(int sock_fd)
+{
+    UringClient &client = clients_[sock_fd]->uring_;
+    HttpConnection &conn = clients_[sock_fd]->connection_;
+    int count = 0;
+    struct iovec *iov = conn.GetIovec(&count);
+    if (count > 0)
+    {
+        // 后面还有文件内容时带上MSG_MORE，让内核把响应头和文件开头合并成满的报文段
+        memset(&client.message_, 0, sizeof(client.message_));
+        client.message_.msg_iov = iov;
+        client.message_.msg_iovlen = count;
+        client.sending_ = true;
+        unsigned flags = MSG_NOSIGNAL | (conn.HasFileToSend() ? MSG_MORE : 0);
+        ring_.PrepSendmsg(sock_fd, &client.message_, flags, MakeUserData(URING_SEND, sock_fd));
+        return;
+    }
+    // io_uring没有sendfile操作，文件内容在反应堆线程内用非阻塞的sendfile直接从页缓存发送，
+    // socket发送缓冲区满时等待其可写
+    ssize_t sent = conn.SendFile();
+    if (sent == -1 && errno == EAGAIN)
+    {
+        client.sending_ = true;
+        ring_.PrepPollAdd(sock_fd, POLLOUT, MakeUserData(URING_WRITABLE, sock_fd));
+        return;
+    }
+    UringSendComplete(sock_fd, sent == -1 ? -errno : (int)sent);
+}
+
+void Reactor::UringSendComplete(int sock_fd, int result)
+{
+    UringClient &client = clients_[sock_fd]->uring_;
+    HttpConnection &conn = clients_[sock_fd]->connection_;
+    client.sending_ = false;
+    if (client.closing_)
+    {
+        if (!client.receiving_)
+            UringFinishClose(sock_fd);
+        return;
+    }
+    if (result <= 0)
+    {
+        conn.FinishWrite();
+        CloseClient(sock_fd);
+        return;
+    }
+    if (!conn.AdvanceWrite(result))
+    {
+        // 只发送了一部分，继续发送剩余部分
+        UringSend(sock_fd);
+        return;
+    }
+    RefreshTimer(sock_fd);
+    if (!conn.FinishWrite())
+    {
+        CloseClient(sock_fd);
+        return;
+    }
+    // 长连接：处理发送期间已经收到的数据，以及流水线中尚未处理的请求
+    if (!client.pending_input_.empty())
+    {
+        std::string input;
+        input.swap(client.pending_input_);
+        UringHandleInput(sock_fd, input.data(), input.size());
+    }
+    else if (conn.HasBufferedInput())
+    {
+        UringProcess(sock_fd);
+    }
+}
+
+void Reactor::UringWritable(int sock_fd, int result)
+{
+    UringClient &client = clients_[sock_fd]->uring_;
+    client.sending_ = false;
+    if (client.closing_)
+    {
+        if (!client.receiving_)
+            UringFinishClose(sock_fd);
+        return;
+    }
+    if (result < 0)
+    {
+        clients_[sock_fd]->connection_.FinishWrite();
+        CloseClient(sock_fd);
+        return;
+    }
+    UringSend(sock_fd);
+}
+
+void Reactor::UringFinishClose(int sock_fd)
+{
+    FreeClient(sock_fd);
+    close(sock_fd);
+    HttpConnection::user_count_--;
+    --connection_count_;
+    LOG_INFO("Close fd %d", sock_fd);
+    Logger::GetInstance()->Flush();
+}
+
+#endif
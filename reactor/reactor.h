@@ -0,0 +1,193 @@
+#ifndef REACTOR_REACTOR_
+#define REACTOR_REACTOR_
+
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <netinet/in.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "threadpool/thread_pool.h"
+#include "time/timing_wheel.h"
+#include "http/http_connection.h"
+#include "cgi/mysql_connect_pool.h"
+#include "reactor/spsc_queue.h"
+#include "reactor/io_uring.h"
+#include "pool/object_pool.h"
+
+#include "config.inc"
+
+// 由主反应堆交给从反应堆的新连接
+struct PendingConnection
+{
+    int socket_fd_;
+    sockaddr_in address_;
+};
+
+#ifdef IO_URING
+// io_uring后端中每个连接的状态，连接只有在没有未完成的请求时才能真正关闭
+struct UringClient
+{
+    // 多次触发的recv是否仍有效
+    bool receiving_;
+    // 是否有sendmsg或等待可写的poll尚未完成
+    bool sending_;
+    // 是否正在关闭，等待未完成的请求结束
+    bool closing_;
+    msghdr message_;
+    // 发送响应期间收到的数据，发送完成后再交给连接解析
+    std::string pending_input_;
+};
+#endif
+
+// 一个连接的全部状态，accept时从所属反应堆的对象池中取出，关闭时归还
+struct Client
+{
+    HttpConnection connection_;
+    ClientData user_data_;
+#ifdef IO_URING
+    UringClient uring_;
+#endif
+};
+
+// 反应堆：持有一个epoll实例、一个监听socket和一个定时器时间轮，负责accept、读写和超时连接的清理。
+// 多反应堆模式下每个线程运行一个实例，连接表按fd索引，
+// 而每个fd只会被accept它的反应堆处理，因此各反应堆天然地只操作连接表中属于自己的那一部分。
+// 连接表只存指针，连接对象由处理它的反应堆从自己的对象池中分配，关闭时归还。
+// 主从反应堆模式下主反应堆只负责accept，新连接经无锁队列交给从反应堆，并用eventfd唤醒对方，
+// 从反应堆不监听端口（listen_fd为-1），只处理交给自己的连接。
+// 定义IO_URING时事件循环改由io_uring驱动：多次触发的accept和recv、内核提供的接收缓冲区、
+// 以sendmsg提交响应头、以sendfile发送文件，请求在反应堆线程内直接解析并生成响应，不再经过线程池
+class Reactor
+{
+public:
+    // 交接队列的容量
+    static const int HANDOFF_QUEUE_SIZE = 4096;
+    // io_uring提交队列长度、接收缓冲区个数（须为2的幂）和大小
+    static const int URING_ENTRIES = 1024,
+                     URING_BUFFER_NUMBER = 1024,
+                     URING_BUFFER_SIZE = 2048;
+    // 对象池中最多缓存的空闲连接对象数
+    static const int CLIENT_CACHE_NUMBER = 1024;
+
+    Reactor(int listen_fd,
+            Client **clients,
+            ThreadPool<HttpConnection> *pool,
+            ConnectPool *conn_pool);
+    ~Reactor();
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    // 事件循环，Stop后返回
+    void Loop();
+    // 在Loop之前调用：由本反应堆读取signalfd，收到SIGTERM时让reactors中的每个反应堆退出
+    void WatchSignals(int signal_fd, const std::vector<Reactor *> &reactors);
+    // 让事件循环在本轮结束后返回，可由任意线程调用
+    void Stop();
+    // 设置从反应堆，设置后本反应堆accept到的连接全部交给从反应堆处理
+    void SetSubReactors(const std::vector<Reactor *> &sub_reactors) { sub_reactors_ = sub_reactors; }
+    // 由主反应堆线程调用，把新连接放入交接队列并唤醒本反应堆；队列已满时返回false
+    bool Handoff(int conn_fd, const sockaddr_in &address);
+    // 当前由本反应堆管理的连接数
+    int GetConnectionCount() const { return connection_count_; }
+    // 关闭连接、解除epoll注册并归还连接对象，由超时回调和CloseClient调用，不处理定时器
+    void ReleaseClient(ClientData *user_data);
+
+private:
+    // 接受新连接
+    void DealWithAccept();
+    // 取出交接队列中的新连接
+    void DealWithHandoff();
+    // 处理从signalfd读到的信号
+    void DealWithSignal(int sig);
+    // timerfd到期后推进时间轮，关闭超时连接
+    void DealWithTimeout();
+    // 开始或停止timerfd的周期触发
+    void ArmTimer(bool enable);
+    void DealWithRead(int sock_fd);
+    void DealWithWrite(int sock_fd);
+    // 连接有读写时推迟其超时时间
+    void RefreshTimer(int sock_fd);
+    // 在本反应堆处理新连接，或者把它交给某个从反应堆
+    void DispatchClient(int conn_fd, const sockaddr_in &address);
+    // 初始化新连接并为其注册定时器
+    void AddClient(int conn_fd, const sockaddr_in &address);
+    // 关闭连接并删除其定时器
+    void CloseClient(int sock_fd);
+    // 把连接对象还给对象池
+    void FreeClient(int sock_fd);
+    // 把连接交给线程池并记为在途，队列已满时返回false
+    bool Dispatch(int sock_fd);
+    // 关闭fd并归还连接对象，连接须已解除epoll注册且不在线程池中
+    void FinishClose(int sock_fd);
+    // 回收推迟关闭的连接中已经处理完的那些
+    void SweepDeferred();
+
+#ifdef IO_URING
+    // io_uring完成事件的种类，与fd一起编码在user_data中
+    enum UringEvent
+    {
+        URING_ACCEPT,
+        URING_RECV,
+        URING_SEND,
+        URING_WRITABLE,
+        URING_SIGNAL,
+        URING_TIMER,
+        URING_WAKEUP,
+        URING_CANCEL
+    };
+    // 由io_uring驱动的事件循环
+    void UringLoop();
+    void UringDispatch(io_uring_cqe *cqe, bool &time_out);
+    void UringAccept(io_uring_cqe *cqe);
+    void UringReceive(int sock_fd, io_uring_cqe *cqe);
+    void UringHandleInput(int sock_fd, const char *data, size_t length);
+    // 解析读缓冲区中的请求，有响应时开始发送
+    void UringProcess(int sock_fd);
+    void UringSend(int sock_fd);
+    void UringSendComplete(int sock_fd, int result);
+    // 发送文件时socket重新变为可写
+    void UringWritable(int sock_fd, int result);
+    // 所有未完成的请求都结束后真正关闭连接
+    void UringFinishClose(int sock_fd);
+    static uint64_t MakeUserData(UringEvent event, int fd) { return (uint64_t)event << 32 | (uint32_t)fd; }
+#endif
+
+    int listen_fd_;
+    int epoll_fd_;
+    // 交接队列非空或要求退出时写入的eventfd
+    int wakeup_fd_;
+    epoll_event *events_;
+    // 本反应堆的定时器时间轮，由timer_fd_按TIMER_TICK_MS推进，时间轮为空时停止
+    TimingWheel time_list_;
+    int timer_fd_;
+    bool timer_armed_;
+    // 由本反应堆读取的signalfd，没有时为-1；收到SIGTERM时要通知的反应堆
+    int signal_fd_;
+    std::vector<Reactor *> stop_targets_;
+    std::atomic<bool> stop_;
+    // 要关闭时仍在线程池中的连接，已解除epoll注册，处理完后由timerfd触发回收
+    std::vector<int> deferred_;
+    // 按fd索引的连接表，所有反应堆共用
+    Client **clients_;
+    ObjectPool<Client> client_pool_;
+    ThreadPool<HttpConnection> *pool_;
+    ConnectPool *conn_pool_;
+    // 主反应堆交来的新连接
+    SpscQueue<PendingConnection> handoff_queue_;
+    std::atomic<int> connection_count_;
+    // 主反应堆使用：从反应堆和下一个轮询位置
+    std::vector<Reactor *> sub_reactors_;
+    size_t next_sub_reactor_;
+#ifdef IO_URING
+    IoUring ring_;
+    // signalfd、timerfd和eventfd的读缓冲区
+    signalfd_siginfo signal_info_;
+    uint64_t timer_count_;
+    uint64_t wakeup_count_;
+#endif
+};
+
+#endif
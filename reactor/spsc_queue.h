@@ -0,0 +1,57 @@
+#ifndef REACTOR_SPSCQUEUE_
+#define REACTOR_SPSCQUEUE_
+
+#include <cstddef>
+#include <atomic>
+
+// 单生产者单消费者的无锁环形队列，容量向上取整为2的幂。
+// 生产者只写tail_，消费者只写head_，两者分处不同缓存行以避免伪共享
+template <class T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity) : head_(0), tail_(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        mask_ = size - 1;
+        buffer_ = new T[size];
+    }
+    ~SpscQueue()
+    {
+        delete[] buffer_;
+    }
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // 仅由生产者调用，队列已满时返回false
+    bool Push(const T &item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_)
+            return false;
+        buffer_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 仅由消费者调用，队列为空时返回false
+    bool Pop(T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    alignas(64) size_t mask_;
+    T *buffer_;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef SEMAPHORE_EVENTCOUNT_
+#define SEMAPHORE_EVENTCOUNT_
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <atomic>
+
+// 基于futex的事件计数，用于空闲线程休眠。等待方先PrepareWait，再检查一次条件，
+// 条件仍不满足才Wait，否则CancelWait；通知方在条件满足后Notify。
+// 没有线程在等待时Notify只是一次原子读，不加锁也不进内核
+class EventCount
+{
+public:
+    EventCount() : epoch_(0), waiters_(0) {}
+    EventCount(const EventCount &) = delete;
+    EventCount &operator=(const EventCount &) = delete;
+
+    uint32_t PrepareWait()
+    {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_acquire);
+    }
+    void CancelWait()
+    {
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // PrepareWait之后有过Notify时立即返回
+    void Wait(uint32_t key)
+    {
+        while (epoch_.load(std::memory_order_acquire) == key)
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch_), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+        }
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void NotifyOne() { Notify(1); }
+    void NotifyAll() { Notify(INT32_MAX); }
+
+private:
+    void Notify(int count)
+    {
+        // 与PrepareWait中的fetch_add配对：要么通知方看到等待者，要么等待方看到新条件
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) == 0)
+            return;
+        epoch_.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch_), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    alignas(64) std::atomic<uint32_t> epoch_;
+    std::atomic<int> waiters_;
+};
+
+#endif
@@ -0,0 +1,149 @@
+// 分块编码响应的测试，需要先在本机启动服务器。
+// 在一个长连接上先后请求状态页（分块编码）和首页，逐块检查状态页的格式：
+// 十六进制的块大小行、块数据后的"\r\n"、以"0\r\n\r\n"结束，且结束之后紧接着就是下一个响应。
+// 用法：chunked_response_test 端口
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace
+{
+// 两次收到数据之间最多等待的时间
+const int READ_TIMEOUT_MS = 5000;
+
+int failures = 0;
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            fflush(stdout);                                                     \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+// 保证received中至少有size字节，超时或连接关闭时返回false
+bool Receive(int fd, std::string *received, size_t size)
+{
+    while (received->size() < size)
+    {
+        pollfd readable = {fd, POLLIN, 0};
+        if (poll(&readable, 1, READ_TIMEOUT_MS) <= 0)
+            return false;
+        char buffer[4096];
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0)
+            return false;
+        received->append(buffer, count);
+    }
+    return true;
+}
+
+// 读到pattern为止，返回其后的位置，失败时返回npos
+size_t ReceiveUntil(int fd, std::string *received, size_t from, const char *pattern)
+{
+    while (true)
+    {
+        size_t found = received->find(pattern, from);
+        if (found != std::string::npos)
+            return found + strlen(pattern);
+        if (!Receive(fd, received, received->size() + 1))
+            return std::string::npos;
+    }
+}
+
+// 从position开始解码分块编码的正文，返回最后一块之后的位置，格式错误时返回npos
+size_t ReadChunkedBody(int fd, std::string *received, size_t position, std::string *body, int *chunks)
+{
+    *chunks = 0;
+    while (true)
+    {
+        size_t line_end = ReceiveUntil(fd, received, position, "\r\n");
+        if (line_end == std::string::npos)
+            return std::string::npos;
+        std::string size_line = received->substr(position, line_end - 2 - position);
+        // 块大小只能是十六进制数字，服务器不发送块扩展
+        if (size_line.empty() || size_line.find_first_not_of("0123456789abcdef") != std::string::npos)
+        {
+            printf("bad chunk size line \"%s\"\n", size_line.c_str());
+            return std::string::npos;
+        }
+        size_t size = strtoul(size_line.c_str(), nullptr, 16);
+        position = line_end;
+        if (size == 0)
+        {
+            // 没有尾部字段，最后一块之后只有一个空行
+            if (!Receive(fd, received, position + 2) || received->compare(position, 2, "\r\n") != 0)
+                return std::string::npos;
+            return position + 2;
+        }
+        if (!Receive(fd, received, position + size + 2) || received->compare(position + size, 2, "\r\n") != 0)
+        {
+            printf("chunk of %zu bytes is not followed by CRLF\n", size);
+            return std::string::npos;
+        }
+        body->append(*received, position, size);
+        position += size + 2;
+        ++*chunks;
+    }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc <= 1)
+    {
+        printf("Usage: %s port_number\n", basename(argv[0]));
+        return 1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(atoi(argv[1]));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        printf("cannot connect to port %s\n", argv[1]);
+        return 1;
+    }
+    const char requests[] = "GET /status HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n"
+                            "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+    CHECK(send(fd, requests, strlen(requests), 0) == (ssize_t)strlen(requests));
+
+    std::string received;
+    size_t body_start = ReceiveUntil(fd, &received, 0, "\r\n\r\n");
+    CHECK(body_start != std::string::npos);
+    if (body_start != std::string::npos)
+    {
+        std::string headers = received.substr(0, body_start);
+        CHECK(headers.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        CHECK(headers.find("\r\nTransfer-Encoding: chunked\r\n") != std::string::npos);
+        CHECK(headers.find("Content-Length") == std::string::npos);
+
+        std::string body;
+        int chunks = 0;
+        size_t end = ReadChunkedBody(fd, &received, body_start, &body, &chunks);
+        CHECK(end != std::string::npos);
+        CHECK(chunks > 1);
+        CHECK(body.compare(0, 6, "<html>") == 0);
+        CHECK(body.find("</html>") != std::string::npos);
+        // 最后一块之后紧接着就是下一个响应，说明分块的边界没有多写或少写
+        if (end != std::string::npos)
+        {
+            CHECK(Receive(fd, &received, end + 15));
+            CHECK(received.compare(end, 15, "HTTP/1.1 200 OK") == 0);
+        }
+        printf("status page in %d chunks, %zu bytes: %s\n", chunks, body.size(), failures ? "FAILED" : "ok");
+    }
+    close(fd);
+    return failures ? 1 : 0;
+}
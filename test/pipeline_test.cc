@@ -0,0 +1,153 @@
+// 流水线请求排在大响应之后的回归测试，需要先在本机启动服务器。
+// 在文档根目录下生成一个大文件，一次发出对该文件的请求和首页请求的前一半。
+// 客户端的接收缓冲区很小且先不读，服务器发送第一个响应时必然遇到EAGAIN，
+// 此时读缓冲区中未完整的第二个请求不能交给工作线程，否则它注册的读事件会覆盖等待可写的注册，
+// 第一个响应停在半途。收完第一个响应后才发出第二个请求的其余部分，
+// 检查两个响应都完整地按顺序到达，第一个的正文与文件内容一致。
+// 用法：pipeline_test 端口
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "http/root_path.inc"
+
+namespace
+{
+const char FILE_NAME[] = "/pipeline_test.bin";
+// 远大于socket的发送缓冲区，保证第一个响应要分多次发送
+const size_t FILE_SIZE = 5 * 1024 * 1024;
+// 两次收到数据之间最多等待的时间
+const int READ_TIMEOUT_MS = 5000;
+
+int failures = 0;
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            fflush(stdout);                                                     \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+std::string MakeContent()
+{
+    std::string content(FILE_SIZE, '\0');
+    unsigned state = 1;
+    for (size_t i = 0; i < FILE_SIZE; ++i)
+    {
+        state = state * 1103515245 + 12345;
+        content[i] = (char)(state >> 16);
+    }
+    return content;
+}
+
+// 从socket读取一个完整的响应，received中多读的部分留给下一个响应。超时或连接关闭时返回false
+bool ReadResponse(int fd, std::string *received, std::string *headers, std::string *body)
+{
+    size_t header_end;
+    long content_length = -1;
+    while (true)
+    {
+        header_end = received->find("\r\n\r\n");
+        if (header_end != std::string::npos && content_length < 0)
+        {
+            *headers = received->substr(0, header_end + 4);
+            const char *field = strcasestr(headers->c_str(), "\r\nContent-Length:");
+            if (!field)
+                return false;
+            content_length = atol(field + strlen("\r\nContent-Length:"));
+        }
+        if (content_length >= 0 && received->size() >= header_end + 4 + content_length)
+        {
+            *body = received->substr(header_end + 4, content_length);
+            received->erase(0, header_end + 4 + content_length);
+            return true;
+        }
+        pollfd readable = {fd, POLLIN, 0};
+        if (poll(&readable, 1, READ_TIMEOUT_MS) <= 0)
+        {
+            printf("timed out with %zu bytes of the response received\n", received->size());
+            return false;
+        }
+        char buffer[64 * 1024];
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0)
+            return false;
+        received->append(buffer, count);
+    }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc <= 1)
+    {
+        printf("Usage: %s port_number\n", basename(argv[0]));
+        return 1;
+    }
+    std::string path = std::string(ROOT_PATH) + FILE_NAME;
+    std::string content = MakeContent();
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file || fwrite(content.data(), 1, content.size(), file) != content.size())
+    {
+        printf("cannot write %s\n", path.c_str());
+        return 1;
+    }
+    fclose(file);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    // 接收缓冲区要在connect之前设置，窗口在握手时协商
+    int buffer_size = 16 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(atoi(argv[1]));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        printf("cannot connect to port %s\n", argv[1]);
+        unlink(path.c_str());
+        return 1;
+    }
+    std::string requests = std::string("GET ") + FILE_NAME +
+                           " HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n"
+                           "GET / HTTP/1.1\r\nHost: local";
+    const char rest[] = "host\r\nConnection: keep-alive\r\n\r\n";
+    CHECK(send(fd, requests.data(), requests.size(), 0) == (ssize_t)requests.size());
+    // 先不读，让服务器的发送缓冲区写满
+    usleep(300 * 1000);
+
+    std::string received, headers, body;
+    bool first = ReadResponse(fd, &received, &headers, &body);
+    CHECK(first);
+    if (first)
+    {
+        CHECK(headers.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        CHECK(body.size() == FILE_SIZE);
+        CHECK(body == content);
+        CHECK(received.empty());
+    }
+    CHECK(send(fd, rest, strlen(rest), 0) == (ssize_t)strlen(rest));
+    bool second = first && ReadResponse(fd, &received, &headers, &body);
+    CHECK(second);
+    if (second)
+    {
+        CHECK(headers.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        CHECK(body.find("</html>") != std::string::npos);
+        CHECK(received.empty());
+    }
+    close(fd);
+    unlink(path.c_str());
+    printf("pipelined request behind a %zu byte response: %s\n", FILE_SIZE, failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
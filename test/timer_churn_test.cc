@@ -0,0 +1,198 @@
+// 连接反复建立、超时和关闭后定时器不泄漏的测试。
+// 按反应堆中的做法把定时器嵌在从对象池取出的连接对象里：接入时加入时间轮，有读写时推迟，
+// 对端关闭时先取消定时器再归还对象，超时由回调归还对象。默认跑过数百万个连接，之后检查：
+// 时间轮为空、没有存活的连接对象、回调从未对已归还的连接触发，且每个连接恰好关闭一次；
+// 预热后的稳态中没有任何堆分配，malloc统计的已用内存与开始时相同。
+// 用法：timer_churn_test [轮数]
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <new>
+#include <random>
+#include <vector>
+
+#include "pool/object_pool.h"
+#include "time/lst_time.h"
+#include "time/timing_wheel.h"
+
+namespace
+{
+const int TICK_MS = 100;
+const time_t TIMEOUT_MS = 15000;
+// 对象池缓存的空闲对象数，与反应堆的CLIENT_CACHE_NUMBER相同
+const size_t CLIENT_CACHE_NUMBER = 1024;
+// 连接表的大小，相当于fd的上限，同时存在的连接不超过对象池的缓存；每轮随机接入、活动和关闭的次数
+const int MAX_FD = CLIENT_CACHE_NUMBER;
+const int EVENTS_PER_ROUND = 2000;
+
+struct TestClient
+{
+    TestClient() { ++live_; }
+    ~TestClient() { --live_; }
+    ClientData user_data_;
+    static int live_;
+};
+int TestClient::live_ = 0;
+
+int failures = 0;
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            fflush(stdout);                                                     \
+            ++failures;                                                         \
+        }                                                                       \
+    } while (0)
+
+// 模拟单个反应堆：连接表按fd索引，连接对象来自对象池
+class Harness
+{
+public:
+    Harness()
+        : wheel_(TICK_MS), pool_(CLIENT_CACHE_NUMBER), clients_(MAX_FD, nullptr), now_(0), opened_(0), closed_(0), expired_(0)
+    {
+    }
+
+    void Open(int fd)
+    {
+        TestClient *client = pool_.Acquire();
+        clients_[fd] = client;
+        ClientData &user_data = client->user_data_;
+        user_data.socket_fd_ = fd;
+        user_data.reactor_ = nullptr;
+        UtilTimer &timer = user_data.timer_;
+        timer.cb_func_ = Expire;
+        timer.user_data_ = &user_data;
+        timer.expire_time_ = now_ + TIMEOUT_MS;
+        wheel_.AddTimer(&timer);
+        ++opened_;
+    }
+    // 有读写，推迟超时
+    void Refresh(int fd)
+    {
+        UtilTimer &timer = clients_[fd]->user_data_.timer_;
+        CHECK(timer.Pending());
+        timer.expire_time_ = now_ + TIMEOUT_MS;
+        wheel_.AdjustTimer(&timer);
+    }
+    // 对端关闭或出错：先取消定时器再归还
+    void Close(int fd)
+    {
+        wheel_.RemoveTimer(&clients_[fd]->user_data_.timer_);
+        Release(fd);
+    }
+    void Advance(time_t ms)
+    {
+        now_ += ms;
+        wheel_.Tick(now_);
+    }
+
+    TimingWheel wheel_;
+    ObjectPool<TestClient> pool_;
+    std::vector<TestClient *> clients_;
+    time_t now_;
+    long opened_;
+    long closed_;
+    long expired_;
+    static Harness *current_;
+
+private:
+    static void Expire(ClientData *user_data)
+    {
+        Harness *harness = current_;
+        int fd = user_data->socket_fd_;
+        // 回调只能对仍然打开、且就是这个连接对象的fd触发，否则是泄漏的定时器，不能再归还
+        bool owned = fd >= 0 && fd < MAX_FD && harness->clients_[fd] &&
+                     &harness->clients_[fd]->user_data_ == user_data;
+        CHECK(owned);
+        if (!owned)
+            return;
+        CHECK(!user_data->timer_.Pending());
+        CHECK(user_data->timer_.expire_time_ <= harness->now_);
+        ++harness->expired_;
+        harness->Release(fd);
+    }
+    void Release(int fd)
+    {
+        pool_.Release(clients_[fd]);
+        clients_[fd] = nullptr;
+        ++closed_;
+    }
+};
+Harness *Harness::current_ = nullptr;
+} // namespace
+
+// 统计堆分配的次数，只有一个线程，不必用原子变量
+size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *memory = malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 5000;
+    if (rounds <= 0)
+        rounds = 5000;
+    Harness harness;
+    Harness::current_ = &harness;
+    std::mt19937 random(1);
+    // 预热：每个fd各接入一次，对象池中的对象数达到同时存在的连接数的上限，之后全部复用
+    for (int fd = 0; fd < MAX_FD; ++fd)
+        harness.Open(fd);
+    size_t steady_allocations = allocations;
+    size_t steady_heap = mallinfo2().uordblks;
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (int i = 0; i < EVENTS_PER_ROUND; ++i)
+        {
+            int fd = random() % MAX_FD;
+            int action = random() % 10;
+            if (!harness.clients_[fd])
+                harness.Open(fd);
+            else if (action < 6)
+                harness.Refresh(fd);
+            else
+                harness.Close(fd);
+        }
+        // 每轮推进的时间在一格到两倍超时之间，一部分连接在两轮之间超时
+        harness.Advance(TICK_MS + random() % (2 * TIMEOUT_MS));
+        CHECK(harness.wheel_.Size() == TestClient::live_);
+        CHECK(harness.opened_ - harness.closed_ == TestClient::live_);
+    }
+    // churn期间必须既有超时也有主动关闭，否则测试没有覆盖两条路径
+    CHECK(harness.expired_ > 0 && harness.expired_ < harness.closed_);
+    // 剩下的连接全部等到超时
+    harness.Advance(TIMEOUT_MS + TICK_MS);
+    // 在输出任何内容之前取得统计，标准输出的缓冲区也是堆上分配的
+    steady_allocations = allocations - steady_allocations;
+    bool heap_flat = mallinfo2().uordblks == steady_heap;
+    CHECK(steady_allocations == 0);
+    CHECK(heap_flat);
+
+    CHECK(harness.wheel_.Size() == 0);
+    CHECK(TestClient::live_ == 0);
+    CHECK(harness.opened_ == harness.closed_);
+    for (int fd = 0; fd < MAX_FD; ++fd)
+        CHECK(harness.clients_[fd] == nullptr);
+    printf("%d rounds, %ld connections opened and closed, %ld of them timed out, %zu heap allocations after "
+           "warm-up: %s\n",
+           rounds, harness.opened_, harness.expired_, steady_allocations, failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+#ifndef THREADPOOL_MPMCQUEUE_
+#define THREADPOOL_MPMCQUEUE_
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+// 多生产者多消费者的有界无锁环形队列（Vyukov），容量向上取整为2的幂。
+// 每个槽带一个序号，生产者和消费者各自用CAS抢占位置，再按序号判断槽是否可写或可读；
+// 队列满或空时立即返回false，不等待
+template <class T>
+class MpmcQueue
+{
+public:
+    explicit MpmcQueue(size_t capacity) : head_(0), tail_(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask_ = size - 1;
+        cells_ = new Cell[size];
+        for (size_t i = 0; i < size; ++i)
+            cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+    ~MpmcQueue()
+    {
+        delete[] cells_;
+    }
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    // 队列已满时返回false
+    bool Push(const T &item)
+    {
+        Cell *cell;
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &cells_[tail & mask_];
+            size_t sequence = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)tail;
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // 槽中还是上一圈未取走的元素
+                return false;
+            }
+            else
+            {
+                tail = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item_ = item;
+        cell->sequence_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列为空时返回false
+    bool Pop(T &item)
+    {
+        Cell *cell;
+        size_t head = head_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &cells_[head & mask_];
+            size_t sequence = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(head + 1);
+            if (diff == 0)
+            {
+                if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                head = head_.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->item_;
+        cell->sequence_.store(head + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似的元素个数
+    size_t Size() const
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence_;
+        T item_;
+    };
+
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    alignas(64) size_t mask_;
+    Cell *cells_;
+};
+
+#endif
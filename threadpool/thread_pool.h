@@ -4,45 +4,66 @@
 #include <pthread.h>
 
 #include <cstdio>
-#include <list>
+#include <atomic>
 #include <exception>
 #include <vector>
 
-#include "semaphore/semaphore.h"
+#include "semaphore/event_count.h"
+#include "threadpool/mpmc_queue.h"
+#include "threadpool/work_stealing_deque.h"
 #include "cgi/mysql_connect_pool.h"
+#include "time/coarse_clock.h"
+#include "cpu/cpu_placement.h"
 #include "config.inc"
 
+// 工作窃取线程池。反应堆把请求放入无锁的全局注入队列，工作线程每次从中取出一批放入自己的本地队列，
+// 之后只在本地队列上无锁地取任务；本地队列空了先找全局队列，再从其他线程的本地队列顶部窃取。
+// 无事可做的线程在futex事件计数上休眠，有新请求时才唤醒一个
 template <class Request>
 class ThreadPool
 {
-    typedef std::lock_guard<std::mutex> Lock;
-    typedef std::unique_lock<std::mutex> ULock;
-
 public:
-    ThreadPool(ConnectPool *conn_pool, size_t thread_num = 16, size_t max_request = MAX_EVENT_NUMBER);
+    // 每个工作线程本地队列的容量，一次从全局队列最多取出的请求数
+    static const size_t LOCAL_QUEUE_SIZE = 256;
+    static const size_t BATCH_SIZE = 32;
+
+    ThreadPool(ConnectPool *conn_pool, size_t thread_num = THREAD_NUMBER, size_t max_request = MAX_EVENT_NUMBER);
     ~ThreadPool();
-    // 向工作队列添加任务
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    // 向全局队列添加任务，队列已满时立即返回false，由调用者决定如何卸载
     bool Append(Request *request);
 
 private:
-    // 负责取出工作队列中的任务，并执行
-    static void *Worker(void *arg);
-    void Run();
+    struct Worker
+    {
+        Worker(ThreadPool *pool, size_t index) : pool_(pool), index_(index), local_(LOCAL_QUEUE_SIZE) {}
+        ThreadPool *pool_;
+        size_t index_;
+        pthread_t thread_;
+        WorkStealingDeque<Request *> local_;
+    };
+
+    // 线程入口，负责取出任务并执行
+    static void *WorkerEntry(void *arg);
+    void Run(Worker &worker);
+    // 依次从本地队列、全局队列和其他线程取一个任务，都没有时返回nullptr
+    Request *FindWork(Worker &worker);
+    Request *TakeGlobal(Worker &worker);
+    Request *Steal(Worker &worker);
+    void Execute(Request *request);
 
     // 线程池中的线程数
     size_t thread_number_;
-    // 请求队列中允许的最大请求数
+    // 允许排队的最大请求数，全局队列的容量由它向上取整为2的幂
     size_t max_requests_;
-    // 线程池数组
-    pthread_t *threads_;
-    // 请求队列
-    std::list<Request *> work_queue_;
-    // 用于保护线程池的锁
-    std::mutex mutex_;
-    // 表征是否有任务需要处理的信号量
-    Semaphore queue_state_;
+    std::vector<Worker *> workers_;
+    // 全局注入队列
+    MpmcQueue<Request *> global_;
+    // 空闲线程在此休眠
+    EventCount idle_;
     // 是否结束线程
-    bool stop_;
+    std::atomic<bool> stop_;
     // 数据库连接池
     ConnectPool *sql_conn_pool_;
 };
@@ -53,24 +74,23 @@ ThreadPool<Request>::ThreadPool(ConnectPool *conn_pool,
                                 size_t max_request)
     : thread_number_(thread_number),
       max_requests_(max_request),
-      stop_(false), sql_conn_pool_(conn_pool),
-      queue_state_(0)
+      global_(max_request),
+      stop_(false),
+      sql_conn_pool_(conn_pool)
 {
     if (thread_number <= 0 || max_request <= 0)
     {
         throw std::exception();
     }
-    threads_ = new pthread_t[thread_number_];
+    // 先建好所有本地队列，线程启动后才能互相窃取
     for (size_t i = 0; i < thread_number_; ++i)
     {
-        if (pthread_create(threads_ + i, nullptr, Worker, this) != 0)
-        {
-            delete[] threads_;
-            throw std::exception();
-        }
-        if (pthread_detach(threads_[i]))
+        workers_.push_back(new Worker(this, i));
+    }
+    for (Worker *worker : workers_)
+    {
+        if (pthread_create(&worker->thread_, nullptr, WorkerEntry, worker) != 0)
         {
-            delete[] threads_;
             throw std::exception();
         }
     }
@@ -79,62 +99,123 @@ ThreadPool<Request>::ThreadPool(ConnectPool *conn_pool,
 template <class Request>
 ThreadPool<Request>::~ThreadPool()
 {
-    delete[] threads_;
     stop_ = true;
+    idle_.NotifyAll();
+    for (Worker *worker : workers_)
+    {
+        pthread_join(worker->thread_, nullptr);
+        delete worker;
+    }
 }
 
-// 将事务添加进工作队列中，成功返回true；若队列长度太长，则添加失败，返回false
 template <class Request>
 bool ThreadPool<Request>::Append(Request *request)
 {
+    if (!global_.Push(request))
     {
-        Lock locker(mutex_);
-        if (work_queue_.size() > max_requests_)
-        {
-            return false;
-        }
-        work_queue_.push_back(request);
+        return false;
     }
-
-    queue_state_.notify();
+    idle_.NotifyOne();
     return true;
 }
 
 template <class Request>
-void *ThreadPool<Request>::Worker(void *arg)
+void *ThreadPool<Request>::WorkerEntry(void *arg)
 {
-    ThreadPool<Request> *pool = static_cast<ThreadPool<Request> *>(arg);
-    pool->Run();
-    return pool;
+    Worker *worker = static_cast<Worker *>(arg);
+    CpuPlacement::GetInstance()->PlaceWorker(worker->index_);
+    worker->pool_->Run(*worker);
+    return worker;
 }
 
-// stop_为真表示线程池已被析构
 template <class Request>
-void ThreadPool<Request>::Run()
+void ThreadPool<Request>::Run(Worker &worker)
 {
     while (!stop_)
     {
-        // 从线程池中取出线程，信号量-1
-        Request *request;
-        queue_state_.wait();
+        Request *request = FindWork(worker);
+        if (!request)
         {
-            Lock locker(mutex_);
-            if (work_queue_.empty())
+            // 登记为等待者后再找一次，避免错过登记前放入的任务
+            uint32_t key = idle_.PrepareWait();
+            request = FindWork(worker);
+            if (!request)
             {
+                if (stop_)
+                {
+                    idle_.CancelWait();
+                    break;
+                }
+                idle_.Wait(key);
                 continue;
             }
-            request = work_queue_.front();
-            work_queue_.pop_front();
+            idle_.CancelWait();
         }
-        if (request == nullptr)
-            continue;
-        // 从连接池中取出一个连接
-        request->mysql_ = sql_conn_pool_->GetConnetion();
-        // 处理请求
-        request->Process();
-        // 归还连接
-        sql_conn_pool_->ReleaseConnection(request->mysql_);
+        Execute(request);
+    }
+}
+
+template <class Request>
+Request *ThreadPool<Request>::FindWork(Worker &worker)
+{
+    Request *request;
+    if (worker.local_.Pop(request))
+        return request;
+    if ((request = TakeGlobal(worker)) != nullptr)
+        return request;
+    return Steal(worker);
+}
+
+template <class Request>
+Request *ThreadPool<Request>::TakeGlobal(Worker &worker)
+{
+    Request *request;
+    if (!global_.Pop(request))
+        return nullptr;
+    // 再取大约平均每个线程的份额放入本地队列，留给其他线程的不必再被窃取。
+    // 本地队列此时为空，放得下整批；多出的任务唤醒一个空闲线程来窃取
+    size_t count = (global_.Size() + thread_number_) / thread_number_;
+    if (count > BATCH_SIZE)
+        count = BATCH_SIZE;
+    size_t taken = 0;
+    Request *extra;
+    while (taken + 1 < count && global_.Pop(extra))
+    {
+        worker.local_.Push(extra);
+        ++taken;
     }
+    if (taken > 0)
+        idle_.NotifyOne();
+    return request;
+}
+
+template <class Request>
+Request *ThreadPool<Request>::Steal(Worker &worker)
+{
+    Request *request;
+    for (size_t i = 1; i < thread_number_; ++i)
+    {
+        Worker *victim = workers_[(worker.index_ + i) % thread_number_];
+        if (victim->local_.Steal(request))
+            return request;
+    }
+    return nullptr;
+}
+
+template <class Request>
+void ThreadPool<Request>::Execute(Request *request)
+{
+    // 本次处理中的日志和Date行都使用开始处理时的时间
+    CoarseClock::Refresh();
+    // 从连接池中取出一个连接。Process返回前请求可能已被再次交给其他线程，归还时不能再读request->mysql_
+    MYSQL *mysql = sql_conn_pool_->GetConnetion();
+    request->mysql_ = mysql;
+    // 处理请求
+    request->Process();
+    // 归还连接
+    sql_conn_pool_->ReleaseConnection(mysql);
+    // 最后才结束在途计数，此后反应堆可以回收请求对象
+    request->in_flight_.fetch_sub(1, std::memory_order_release);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,95 @@
+#ifndef THREADPOOL_WORKSTEALINGDEQUE_
+#define THREADPOOL_WORKSTEALINGDEQUE_
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+// 定长的Chase-Lev工作窃取双端队列，容量向上取整为2的幂。
+// 所属线程在底部Push和Pop，其他线程在顶部Steal，只有取最后一个元素时才需要CAS。
+// T须能存入std::atomic，一般为指针
+template <class T>
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(size_t capacity) : top_(0), bottom_(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        mask_ = size - 1;
+        buffer_ = new std::atomic<T>[size];
+    }
+    ~WorkStealingDeque()
+    {
+        delete[] buffer_;
+    }
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // 仅由所属线程调用，队列已满时返回false
+    bool Push(T item)
+    {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        if (bottom - top > (int64_t)mask_)
+            return false;
+        buffer_[bottom & mask_].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 仅由所属线程调用，取最后放入的元素，队列为空时返回false
+    bool Pop(T &item)
+    {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        if (top > bottom)
+        {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = buffer_[bottom & mask_].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // 只剩一个元素，与窃取者竞争
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // 可由任意线程调用，取最早放入的元素，队列为空或与其他线程竞争失败时返回false
+    bool Steal(T &item)
+    {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return false;
+        item = buffer_[top & mask_].load(std::memory_order_relaxed);
+        return top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    }
+
+    // 近似的元素个数
+    size_t Size() const
+    {
+        int64_t size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+        return size > 0 ? size : 0;
+    }
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    alignas(64) size_t mask_;
+    std::atomic<T> *buffer_;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "coarse_clock.h"
+
+namespace
+{
+struct CachedClock
+{
+    // 墙上时间，second_为-1表示本线程还没有刷新过
+    time_t second_;
+    long microsecond_;
+    time_t monotonic_;
+    // 以下格式化结果对应的秒数
+    time_t local_second_;
+    int today_;
+    size_t log_length_;
+    char log_[32];
+    time_t date_second_;
+    size_t date_length_;
+    char date_[64];
+};
+
+thread_local CachedClock cached_clock = {-1, 0, 0, -1, 0, 0, {}, -1, 0, {}};
+
+inline CachedClock &Fresh()
+{
+    if (cached_clock.second_ < 0)
+        CoarseClock::Refresh();
+    return cached_clock;
+}
+
+// 秒数变化后重新计算本地时间
+void FormatLocal(CachedClock &clock)
+{
+    if (clock.local_second_ == clock.second_)
+        return;
+    struct tm local;
+    localtime_r(&clock.second_, &local);
+    clock.today_ = local.tm_mday;
+    clock.log_length_ = snprintf(clock.log_, sizeof(clock.log_), "%d-%02d-%02d %02d:%02d:%02d",
+                                 local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+                                 local.tm_hour, local.tm_min, local.tm_sec);
+    clock.local_second_ = clock.second_;
+}
+} // namespace
+
+void CoarseClock::Refresh()
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    cached_clock.second_ = now.tv_sec;
+    cached_clock.microsecond_ = now.tv_nsec / 1000;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    cached_clock.monotonic_ = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+time_t CoarseClock::Now()
+{
+    return Fresh().second_;
+}
+
+long CoarseClock::Microseconds()
+{
+    return Fresh().microsecond_;
+}
+
+time_t CoarseClock::Milliseconds()
+{
+    return Fresh().monotonic_;
+}
+
+int CoarseClock::Today()
+{
+    CachedClock &clock = Fresh();
+    FormatLocal(clock);
+    return clock.today_;
+}
+
+std::string_view CoarseClock::LogTimestamp()
+{
+    CachedClock &clock = Fresh();
+    FormatLocal(clock);
+    return std::string_view(clock.log_, clock.log_length_);
+}
+
+std::string_view CoarseClock::HttpDate()
+{
+    CachedClock &clock = Fresh();
+    if (clock.date_second_ != clock.second_)
+    {
+        struct tm date;
+        gmtime_r(&clock.second_, &date);
+        clock.date_length_ = strftime(clock.date_, sizeof(clock.date_), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &date);
+        clock.date_second_ = clock.second_;
+    }
+    return std::string_view(clock.date_, clock.date_length_);
+}
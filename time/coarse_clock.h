@@ -0,0 +1,31 @@
+#ifndef TIME_COARSE_CLOCK_H
+#define TIME_COARSE_CLOCK_H
+
+#include <time.h>
+
+#include <string_view>
+
+// 线程局部的缓存时钟。事件循环每轮、工作线程每个任务开始前调用一次Refresh，
+// 其余代码读取缓存的时间，不再各自调用time、gettimeofday或localtime。
+// 日志行的时间前缀和响应的Date行只在秒数变化后第一次读取时重新格式化。
+// 线程第一次读取前没有调用过Refresh时自动刷新一次
+class CoarseClock
+{
+public:
+    // 读取当前的墙上时间和单调时间
+    static void Refresh();
+
+    // 墙上时间的秒数和其中的微秒部分
+    static time_t Now();
+    static long Microseconds();
+    // 单调时钟的毫秒数，用于定时器
+    static time_t Milliseconds();
+    // 本地时间的日期，用于按天切分日志
+    static int Today();
+    // 本地时间"YYYY-MM-DD HH:MM:SS"，不含微秒
+    static std::string_view LogTimestamp();
+    // RFC 7231格式的"Date: ...\r\n"行
+    static std::string_view HttpDate();
+};
+
+#endif
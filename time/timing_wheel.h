@@ -0,0 +1,164 @@
+#ifndef TIME_TIMING_WHEEL_H
+#define TIME_TIMING_WHEEL_H
+
+#include <time.h>
+
+#include "time/lst_time.h"
+
+// 分层时间轮。时间以单调时钟的毫秒计，按tick_ms毫秒一格推进；
+// 每层WHEEL_SLOTS个槽，第level层的一个槽跨WHEEL_SLOTS^level格，
+// 定时器按到期时间与当前时间之差放入能容纳它的最低一层。
+// 插入、调整和删除只是在槽的双向链表上摘挂，均为O(1)；
+// 低层转完一圈时把上一层对应槽中的定时器重新分配到下层。
+// 时间轮不拥有定时器，定时器的内存由使用者管理，释放前须先RemoveTimer
+class TimingWheel
+{
+public:
+    static const int WHEEL_BITS = 6;
+    static const int WHEEL_SLOTS = 1 << WHEEL_BITS;
+    static const int WHEEL_LEVELS = 4;
+    // 超过范围（2^24格）的定时器按最大范围处理，到时重新分配后继续等待
+    static const time_t MAX_DELAY = (time_t)1 << (WHEEL_BITS * WHEEL_LEVELS);
+
+    // 第一次Tick前时间轮为空，会直接跳到当时的时间
+    explicit TimingWheel(int tick_ms) : tick_ms_(tick_ms), current_(0)
+    {
+        for (int i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; ++i)
+            slots_[i] = nullptr;
+        count_ = 0;
+    }
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel &operator=(const TimingWheel &) = delete;
+
+    void AddTimer(UtilTimer *timer)
+    {
+        if (!timer)
+            return;
+        Link(timer, SlotOf(ToTick(timer->expire_time_)));
+    }
+    // 定时器的失效时间修改后重新挂到对应的槽
+    void AdjustTimer(UtilTimer *timer)
+    {
+        if (!timer)
+            return;
+        int slot = SlotOf(ToTick(timer->expire_time_));
+        if (slot == timer->slot_)
+            return;
+        Unlink(timer);
+        Link(timer, slot);
+    }
+    // 取消尚未到期的定时器，不在时间轮中时什么也不做
+    void RemoveTimer(UtilTimer *timer)
+    {
+        if (!timer)
+            return;
+        Unlink(timer);
+    }
+    // 时间轮中等待到期的定时器数
+    int Size() const { return count_; }
+
+    // 逐格推进到now（毫秒），把到期的定时器移出时间轮后执行其回调。
+    // 时间轮为空时直接跳到now，返回时间轮中是否还有定时器
+    bool Tick(time_t now)
+    {
+        now /= tick_ms_;
+        if (count_ == 0)
+        {
+            current_ = now;
+            return false;
+        }
+        while (current_ < now)
+        {
+            ++current_;
+            // 第0层转完一圈，依次把上层到期的槽分配下来
+            for (int level = 1; level < WHEEL_LEVELS && Index(current_, level - 1) == 0; ++level)
+                Cascade(level * WHEEL_SLOTS + Index(current_, level));
+            // 先把整个槽摘下，回调中对其他定时器的操作不影响遍历
+            int slot = Index(current_, 0);
+            UtilTimer *timer = slots_[slot];
+            slots_[slot] = nullptr;
+            while (timer)
+            {
+                UtilTimer *next = timer->next_;
+                timer->slot_ = -1;
+                --count_;
+                timer->prev_ = timer->next_ = nullptr;
+                timer->cb_func_(timer->user_data_);
+                timer = next;
+            }
+        }
+        return count_ != 0;
+    }
+
+private:
+    static int Index(time_t time, int level) { return (time >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1); }
+
+    // 毫秒换算为格，向上取整，定时器不会提前触发
+    time_t ToTick(time_t ms) const { return (ms + tick_ms_ - 1) / tick_ms_; }
+
+    // 以格计的到期时间对应的槽，已过期的定时器放入下一格的槽
+    int SlotOf(time_t expire) const
+    {
+        time_t delay = expire - current_;
+        if (delay <= 0)
+            return Index(current_ + 1, 0);
+        if (delay >= MAX_DELAY)
+        {
+            delay = MAX_DELAY - 1;
+            expire = current_ + delay;
+        }
+        int level = 0;
+        while (delay >= (time_t)1 << (WHEEL_BITS * (level + 1)))
+            ++level;
+        return level * WHEEL_SLOTS + Index(expire, level);
+    }
+
+    void Link(UtilTimer *timer, int slot)
+    {
+        ++count_;
+        timer->slot_ = slot;
+        timer->prev_ = nullptr;
+        timer->next_ = slots_[slot];
+        if (slots_[slot])
+            slots_[slot]->prev_ = timer;
+        slots_[slot] = timer;
+    }
+    void Unlink(UtilTimer *timer)
+    {
+        if (timer->slot_ < 0)
+            return;
+        if (timer->prev_)
+            timer->prev_->next_ = timer->next_;
+        else
+            slots_[timer->slot_] = timer->next_;
+        if (timer->next_)
+            timer->next_->prev_ = timer->prev_;
+        timer->prev_ = timer->next_ = nullptr;
+        timer->slot_ = -1;
+        --count_;
+    }
+
+    // 按新的剩余时间把一个槽中的定时器重新分配到下层。
+    // 在处理当前格的槽之前调用，恰好在当前格到期的定时器放入当前槽
+    void Cascade(int slot)
+    {
+        UtilTimer *timer = slots_[slot];
+        slots_[slot] = nullptr;
+        while (timer)
+        {
+            UtilTimer *next = timer->next_;
+            time_t expire = ToTick(timer->expire_time_);
+            --count_;
+            Link(timer, expire <= current_ ? Index(current_, 0) : SlotOf(expire));
+            timer = next;
+        }
+    }
+
+    const int tick_ms_;
+    // 已经处理到的格，每个槽的链表头，时间轮中的定时器数
+    time_t current_;
+    UtilTimer *slots_[WHEEL_LEVELS * WHEEL_SLOTS];
+    int count_;
+};
+
+#endif